@@ -0,0 +1,37 @@
+//*****************************************************************************
+//	SDI-12 CRC for SDI-12 bridge project
+//
+//	See crc16.h. Two table lookups per character replace the eight
+//	 shift-and-test steps of the bitwise form.
+//*****************************************************************************
+
+#include <avr/pgmspace.h>
+#include "crc16.h"
+
+// CRC of each 4-bit value shifted through the polynomial four times
+static const uint16_t crc16_nibble[16] PROGMEM =
+{
+	0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+	0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+
+uint16_t crc16_update(uint16_t crc, uint8_t c)
+{
+	crc = (crc >> 4) ^ pgm_read_word( &crc16_nibble[(crc ^ c) & 0x0F] );
+	crc = (crc >> 4) ^ pgm_read_word( &crc16_nibble[(crc ^ (c >> 4)) & 0x0F] );
+	return crc;
+}
+
+uint16_t crc16_update_str(uint16_t crc, const char *s)
+{
+	while ( *s )
+		crc = crc16_update( crc, (uint8_t)*s++ );
+	return crc;
+}
+
+void crc16_sdi12_chars(uint16_t crc, char *out)
+{
+	out[0] = 0x40 | (crc >> 12);
+	out[1] = 0x40 | ((crc >> 6) & 0x3F);
+	out[2] = 0x40 | (crc & 0x3F);
+}
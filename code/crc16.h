@@ -0,0 +1,41 @@
+//*****************************************************************************
+//	Header file for SDI-12 CRC for SDI-12 bridge project
+//
+//	CRC-16 as specified for SDI-12 data responses: polynomial 0xA001
+//	 (reflected 0x8005), initial value 0, over every character from the
+//	 address up to the last value. The three CRC characters are the CRC in
+//	 6-bit groups, most significant first, each ORed with 0x40.
+//
+//	The CRC is updated one character at a time from a 16-entry nibble table
+//	 in flash, so it can be accumulated while a response is being built.
+//*****************************************************************************
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <inttypes.h>
+
+#define CRC16_INIT					0x0000
+
+/*
+ * Description: Add one character to a CRC.
+ * Input: CRC so far (CRC16_INIT to start), character
+ * Output: updated CRC
+ */
+uint16_t crc16_update(uint16_t crc, uint8_t c);
+
+/*
+ * Description: Add a null-terminated string to a CRC.
+ * Input: CRC so far, string
+ * Output: updated CRC
+ */
+uint16_t crc16_update_str(uint16_t crc, const char *s);
+
+/*
+ * Description: Write the three SDI-12 CRC characters.
+ * Input: CRC, destination for three characters (not terminated)
+ * Output: none
+ */
+void crc16_sdi12_chars(uint16_t crc, char *out);
+
+#endif
@@ -0,0 +1,89 @@
+//*****************************************************************************
+//	Display module for SDI-12 bridge project
+//
+//	See display.h.
+//*****************************************************************************
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include "display.h"
+
+#if !HEADLESS
+
+#include "dogm.h"
+#include "energy.h"
+
+static char		shadow[DISPLAY_ROWS][DISPLAY_COLS];		// what the display should show
+static char		shown[DISPLAY_ROWS][DISPLAY_COLS];		// what the controller shows
+static uint8_t	cur_x, cur_y;							// shadow cursor
+static uint8_t	lcd_x, lcd_y;							// controller cursor
+static uint8_t	scan;									// cell display_task() looks at next
+
+void display_init(void)
+{
+	dogm_init();
+	dogm_clear();
+	energy_lcd( DISPLAY_CLEAR_US );
+	memset(shown, ' ', sizeof(shown));
+	display_clear();
+	lcd_x = 0;
+	lcd_y = 0;
+}
+
+void display_clear(void)
+{
+	memset(shadow, ' ', sizeof(shadow));
+	cur_x = 0;
+	cur_y = 0;
+}
+
+void display_gotoxy(uint8_t x, uint8_t y)
+{
+	cur_x = x;
+	cur_y = y;
+}
+
+void display_putc(char c)
+{
+	if ( cur_x < DISPLAY_COLS && cur_y < DISPLAY_ROWS )
+		shadow[cur_y][cur_x] = c;
+	cur_x++;
+}
+
+void display_puts(const char *s)
+{
+	while ( *s )
+		display_putc(*s++);
+}
+
+// The scan carries on from where the last call stopped, so a display that
+//  keeps changing is still refreshed all the way along
+bool display_task(void)
+{
+	uint8_t sent = 0, looked, x, y;
+
+	for ( looked = 0; looked < DISPLAY_ROWS * DISPLAY_COLS; looked++ )  {
+		y = scan / DISPLAY_COLS;
+		x = scan % DISPLAY_COLS;
+		if ( shadow[y][x] != shown[y][x] )  {
+			if ( sent == DISPLAY_DRAIN_CHARS )
+				return false;
+			if ( x != lcd_x || y != lcd_y )  {
+				dogm_gotoxy(x, y);
+				energy_lcd( DISPLAY_CHAR_US );
+			}
+			dogm_putc( shadow[y][x] );
+			energy_lcd( DISPLAY_CHAR_US );
+			shown[y][x] = shadow[y][x];
+			lcd_x = x + 1;
+			lcd_y = y;
+			sent++;
+		}
+		if ( ++scan == DISPLAY_ROWS * DISPLAY_COLS )
+			scan = 0;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,75 @@
+//*****************************************************************************
+//	Header file for display module for SDI-12 bridge project
+//
+//	All LCD output goes through these functions rather than calling the DOGM
+//	 driver directly, so that display traffic is accounted in the energy
+//	 ledger.
+//
+//	The functions only write a shadow copy of the 2x16 display, so they cost
+//	 no controller time. display_task() brings the controller up to date a
+//	 few characters per call, sending only the characters that differ from
+//	 what it already shows; text past the end of a line is dropped.
+//
+//	A HEADLESS build is for bridges with no display fitted: the functions
+//	 below compile to nothing, the DOGM driver is not used, and the state
+//	 machine leaves out what only the display needed (see main.c).
+//*****************************************************************************
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#define DISPLAY_ROWS				2
+#define DISPLAY_COLS				16
+
+// ST7036 controller busy time
+#define DISPLAY_CHAR_US				27			// character or cursor command
+#define DISPLAY_CLEAR_US			1080		// clear display
+
+#ifndef DISPLAY_DRAIN_CHARS
+#define DISPLAY_DRAIN_CHARS			4			// characters sent per display_task()
+#endif
+
+#ifndef HEADLESS
+#define HEADLESS					false
+#endif
+
+#if HEADLESS
+
+static inline void display_init(void) {}
+static inline void display_clear(void) {}
+static inline void display_gotoxy(uint8_t x, uint8_t y) { (void)x; (void)y; }
+static inline void display_putc(char c) { (void)c; }
+static inline void display_puts(const char *s) { (void)s; }
+static inline bool display_task(void) { return true; }
+
+#else
+
+/*
+ * Description: Initialize the controller and clear it and the shadow copy.
+ * Input: none
+ * Output: none
+ */
+void display_init(void);
+
+void display_clear(void);
+
+void display_gotoxy(uint8_t x, uint8_t y);
+
+void display_putc(char c);
+
+void display_puts(const char *s);
+
+/*
+ * Description: Send up to DISPLAY_DRAIN_CHARS changed characters, with the
+ *				cursor commands they need. Call once per main loop pass.
+ * Input: none
+ * Output: true if the controller now matches the shadow copy
+ */
+bool display_task(void);
+
+#endif
+
+#endif
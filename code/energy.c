@@ -0,0 +1,130 @@
+//*****************************************************************************
+//	Energy ledger for SDI-12 bridge project
+//
+//	See energy.h. The tick only counts; charge is worked out once per cycle
+//	 in energy_end_cycle(), away from the interrupt.
+//*****************************************************************************
+
+#include <string.h>
+#include <avr/interrupt.h>
+#include "energy.h"
+#include "display.h"
+#include "format.h"
+
+#define NAH_PER_UA_US				3600000000ULL	// uA * us in one nAh * 1000
+
+static const uint32_t on_ua[ENERGY_LOADS] =
+	{ ENERGY_RADIO_ON_UA, ENERGY_MCU_ON_UA, ENERGY_PROBES_ON_UA };
+static const uint32_t off_ua[ENERGY_LOADS] =
+	{ ENERGY_RADIO_OFF_UA, ENERGY_MCU_OFF_UA, ENERGY_PROBES_OFF_UA };
+
+_energy_cycle			energy_last;
+uint16_t				energy_cycles;
+
+static volatile uint8_t		load_count[ENERGY_LOADS];
+static volatile uint32_t	ticks;
+static volatile uint32_t	on_ticks[ENERGY_LOADS];
+static volatile uint32_t	lcd_us;
+static uint32_t				idle_us;
+
+void energy_init(void)
+{
+	load_count[ENERGY_RADIO] = 1;
+	load_count[ENERGY_MCU] = 1;
+}
+
+void energy_set(uint8_t load, bool on)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	if ( load != ENERGY_PROBES )
+		load_count[load] = on;
+	else if ( on )
+		load_count[load]++;
+	else if ( load_count[load] )
+		load_count[load]--;
+	SREG = sreg;
+}
+
+void energy_tick(void)
+{
+	uint8_t load;
+
+	ticks++;
+	for ( load = 0; load < ENERGY_LOADS; load++ )
+		on_ticks[load] += load_count[load];
+}
+
+uint32_t energy_cycle_ticks(void)
+{
+	uint8_t sreg = SREG;
+	uint32_t t;
+
+	cli();
+	t = ticks;
+	SREG = sreg;
+	return t;
+}
+
+void energy_lcd(uint16_t us)
+{
+	lcd_us += us;
+}
+
+void energy_idle(uint16_t us)
+{
+	idle_us += us;
+}
+
+// uA over a number of microseconds, in nAh
+static uint32_t charge_nAh(uint32_t ua, uint64_t us)
+{
+	return (uint32_t)( (ua * us * 1000ULL + NAH_PER_UA_US / 2) / NAH_PER_UA_US );
+}
+
+void energy_end_cycle(void)
+{
+	uint8_t load, sreg = SREG;
+	_energy_cycle c;
+
+	cli();
+	c.ticks = ticks;
+	for ( load = 0; load < ENERGY_LOADS; load++ )  {
+		c.on_ticks[load] = on_ticks[load];
+		on_ticks[load] = 0;
+	}
+	c.lcd_us = lcd_us;
+	ticks = 0;
+	lcd_us = 0;
+	SREG = sreg;
+
+	// idle sleep comes off the MCU's on time, in whole ticks
+	c.idle_us = idle_us;
+	idle_us = 0;
+	if ( c.on_ticks[ENERGY_MCU] > c.idle_us / ENERGY_TICK_US )
+		c.on_ticks[ENERGY_MCU] -= c.idle_us / ENERGY_TICK_US;
+	else
+		c.on_ticks[ENERGY_MCU] = 0;
+
+	c.total_nAh = 0;
+	for ( load = 0; load < ENERGY_LOADS; load++ )  {
+		c.load_nAh[load] = charge_nAh( on_ua[load], (uint64_t)c.on_ticks[load] * ENERGY_TICK_US )
+			+ charge_nAh( off_ua[load], c.on_ticks[load] < c.ticks ?
+				(uint64_t)(c.ticks - c.on_ticks[load]) * ENERGY_TICK_US : 0 );
+		c.total_nAh += c.load_nAh[load];
+	}
+	c.lcd_nAh = charge_nAh( ENERGY_LCD_UA, c.lcd_us );
+	if ( !HEADLESS )
+		c.lcd_nAh += charge_nAh( ENERGY_LCD_IDLE_UA, (uint64_t)c.ticks * ENERGY_TICK_US );
+	c.total_nAh += c.lcd_nAh;
+
+	energy_last = c;
+	energy_cycles++;
+}
+
+char *energy_format_mAh(uint32_t nAh, char *buf)
+{
+	format_fixed( buf, (nAh + 500) / 1000, 3, 0 );
+	return buf;
+}
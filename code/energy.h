@@ -0,0 +1,130 @@
+//*****************************************************************************
+//	Header file for energy ledger for SDI-12 bridge project
+//
+//	Keeps a per-cycle account of where the battery charge goes. Loads are
+//	 switched on and off by the state machine; the millisecond timer tick
+//	 (timer.h) adds one tick to every load in its current state. LCD traffic is counted
+//	 in microseconds of controller busy time by the display module; the
+//	 display's standing current is charged for the whole cycle unless the
+//	 build is HEADLESS. Time the MCU sleeps in idle mode is reported by
+//	 timer_sleep() and charged at ENERGY_MCU_OFF_UA.
+//
+//	A cycle ends each time the network goes to sleep and so covers one wake
+//	 period and the sleep period before it. The first cycle also includes
+//	 start-up, node discovery and initialization.
+//
+//	Currents are in uA and can be overridden on the compiler command line.
+//*****************************************************************************
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// Loads
+#define ENERGY_RADIO				0			// XBee awake with the network
+#define ENERGY_MCU					1			// MCU running (not in a sleep mode)
+#define ENERGY_PROBES				2			// node probes powered, counted per node
+#define ENERGY_LOADS				3
+
+// Current coefficients, uA
+#ifndef ENERGY_RADIO_ON_UA
+#define ENERGY_RADIO_ON_UA			45000UL		// XBee-PRO DigiMesh receiving
+#endif
+#ifndef ENERGY_RADIO_OFF_UA
+#define ENERGY_RADIO_OFF_UA			50UL		// XBee cyclic sleep
+#endif
+#ifndef ENERGY_MCU_ON_UA
+#define ENERGY_MCU_ON_UA			13000UL		// ATmega644P active, 16 MHz, 5 V
+#endif
+#ifndef ENERGY_MCU_OFF_UA
+#define ENERGY_MCU_OFF_UA			4000UL		// ATmega644P idle
+#endif
+#ifndef ENERGY_PROBES_ON_UA
+#define ENERGY_PROBES_ON_UA			20000UL		// both probes on one node
+#endif
+#ifndef ENERGY_PROBES_OFF_UA
+#define ENERGY_PROBES_OFF_UA		0UL
+#endif
+#ifndef ENERGY_LCD_UA
+#define ENERGY_LCD_UA				1000UL		// DOGM controller while writing
+#endif
+#ifndef ENERGY_LCD_IDLE_UA
+#define ENERGY_LCD_IDLE_UA			250UL		// DOGM module powered, no backlight
+#endif
+
+#define ENERGY_TICK_US				1000UL		// timer tick
+
+typedef struct
+{
+	uint32_t	ticks;						// length of the cycle
+	uint32_t	on_ticks[ENERGY_LOADS];		// time each load was on (probes: node-ticks)
+	uint32_t	lcd_us;						// LCD controller busy time
+	uint32_t	idle_us;					// MCU asleep, included in the MCU's off ticks
+	uint32_t	load_nAh[ENERGY_LOADS];		// charge per load, on and off
+	uint32_t	lcd_nAh;
+	uint32_t	total_nAh;
+} _energy_cycle;
+
+extern _energy_cycle	energy_last;		// last completed cycle
+extern uint16_t			energy_cycles;		// completed cycles since reset
+
+/*
+ * Description: Start the ledger with the MCU and radio on, probes off.
+ * Input: none
+ * Output: none
+ */
+void energy_init(void);
+
+/*
+ * Description: Switch a load on or off from now on. ENERGY_PROBES counts
+ *				nodes: each call adds or removes one node's probes.
+ * Input: load (ENERGY_RADIO, ENERGY_MCU, ENERGY_PROBES), state
+ * Output: none
+ */
+void energy_set(uint8_t load, bool on);
+
+/*
+ * Description: Account one timer tick. Called from TIMER0_COMPA_vect.
+ * Input: none
+ * Output: none
+ */
+void energy_tick(void);
+
+/*
+ * Description: Ticks counted so far in the current cycle.
+ * Input: none
+ * Output: timer ticks since the last energy_end_cycle()
+ */
+uint32_t energy_cycle_ticks(void);
+
+/*
+ * Description: Account LCD controller busy time.
+ * Input: microseconds
+ * Output: none
+ */
+void energy_lcd(uint16_t us);
+
+/*
+ * Description: Account time the MCU spent asleep in idle mode.
+ * Input: microseconds
+ * Output: none
+ */
+void energy_idle(uint16_t us);
+
+/*
+ * Description: Close the current cycle into energy_last and start a new one.
+ * Input: none
+ * Output: none
+ */
+void energy_end_cycle(void);
+
+/*
+ * Description: Format a charge as mAh with three decimals, e.g. "0.452".
+ * Input: charge in nAh, buffer of at least 9 characters
+ * Output: buffer
+ */
+char *energy_format_mAh(uint32_t nAh, char *buf);
+
+#endif
@@ -0,0 +1,51 @@
+//*****************************************************************************
+//	Number formatting for SDI-12 bridge project
+//
+//	See format.h.
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+#include "format.h"
+
+#define FORMAT_DIGITS_MAX			10			// 2^31 has ten digits
+
+static const uint32_t format_pow10[FORMAT_DIGITS_MAX] PROGMEM =
+{
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+	10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+uint8_t format_fixed(char *out, int32_t value, uint8_t decimals, uint8_t flags)
+{
+	char *p = out;
+	uint32_t u = (uint32_t)value, pow;
+	uint8_t i, digit, left;
+	bool started = false;
+
+	if ( decimals > FORMAT_DECIMALS_MAX )
+		decimals = FORMAT_DECIMALS_MAX;
+
+	if ( value < 0 )  {
+		*p++ = '-';
+		u = 0 - u;
+	}
+	else if ( flags & FORMAT_SIGN )
+		*p++ = '+';
+
+	for ( i = 0; i < FORMAT_DIGITS_MAX; i++ )  {
+		left = FORMAT_DIGITS_MAX - 1 - i;		// digits after this one
+		pow = pgm_read_dword( &format_pow10[i] );
+		for ( digit = 0; u >= pow; digit++ )
+			u -= pow;
+		// leading zeros are skipped down to the units digit
+		if ( !started && !digit && left > decimals )
+			continue;
+		started = true;
+		*p++ = '0' + digit;
+		if ( left == decimals && decimals )
+			*p++ = '.';
+	}
+	*p = 0;
+	return p - out;
+}
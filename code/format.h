@@ -0,0 +1,31 @@
+//*****************************************************************************
+//	Header file for number formatting for SDI-12 bridge project
+//
+//	Values are written straight at a cursor in the destination buffer (the
+//	 node response cache, the SDI-12 transmit buffer, an LCD string) and the
+//	 number of characters written is returned, so a line of several values
+//	 is built in one pass: p += format_fixed(p, ...). Digits come out most
+//	 significant first by subtracting powers of ten, so there is no 32-bit
+//	 division and no reversing through a temporary.
+//*****************************************************************************
+
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <inttypes.h>
+
+#define FORMAT_SIGN					0x01		// '+' before values >= 0, as SDI-12 requires
+#define FORMAT_DECIMALS_MAX			9
+
+/*
+ * Description: Write a fixed-point value, value / 10^decimals, e.g. 3050 with
+ *				three decimals is "3.050" and -5 with two is "-0.05". '-' is
+ *				written for negative values, '+' for the others only with
+ *				FORMAT_SIGN. The characters are null-terminated.
+ * Input: destination (13 characters hold any value, fewer when the range is
+ *		  known), value, decimals (0 to FORMAT_DECIMALS_MAX), flags
+ * Output: characters written, not counting the terminator
+ */
+uint8_t format_fixed(char *out, int32_t value, uint8_t decimals, uint8_t flags);
+
+#endif
@@ -0,0 +1,22 @@
+//*****************************************************************************
+//	Host replacement for <avr/eeprom.h> - SDI-12 bridge simulator
+//
+//	EEMEM variables are placed in their own section, which the simulator
+//	 can load from and save to a file so a run can start as a warm restart.
+//	 Each byte written costs the 3.4 ms the target spends programming it.
+//*****************************************************************************
+
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#define EEMEM		__attribute__((section("sim_eeprom")))
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+uint8_t eeprom_read_byte(const uint8_t *p);
+void eeprom_update_byte(uint8_t *p, uint8_t value);
+
+#endif
@@ -0,0 +1,24 @@
+//*****************************************************************************
+//	Host replacement for <avr/interrupt.h> - SDI-12 bridge simulator
+//
+//	ISR() bodies become ordinary functions that sim.c calls when the matching
+//	 flag and enable bits are set and the global interrupt flag is on.
+//*****************************************************************************
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+void sim_sei(void);
+void sim_cli(void);
+
+#define sei()				sim_sei()
+#define cli()				sim_cli()
+
+#define ISR(vector, ...)	void vector(void); void vector(void)
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+
+#endif
@@ -0,0 +1,270 @@
+//*****************************************************************************
+//	Host replacement for <avr/io.h> - SDI-12 bridge simulator
+//
+//	Every I/O register used by the bridge firmware is mapped onto a cell in
+//	 the simulator (sim.c). Each access goes through sim_io(), which advances
+//	 virtual time, lets the peripheral models catch up and dispatches any
+//	 pending interrupts before the firmware sees the register. Writes are
+//	 detected on the next access, so plain assignments and read-modify-write
+//	 operations both work unchanged.
+//
+//	Bit positions are those of the ATmega644P.
+//*****************************************************************************
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <inttypes.h>
+#include <stdint.h>
+
+enum
+{
+	SIM_PINA, SIM_DDRA, SIM_PORTA,
+	SIM_PINB, SIM_DDRB, SIM_PORTB,
+	SIM_PINC, SIM_DDRC, SIM_PORTC,
+	SIM_PIND, SIM_DDRD, SIM_PORTD,
+	SIM_MCUSR, SIM_WDTCSR, SIM_SMCR, SIM_SREG,
+	SIM_PCICR, SIM_PCIFR, SIM_PCMSK0, SIM_PCMSK1, SIM_PCMSK2, SIM_PCMSK3,
+	SIM_TCCR0A, SIM_TCCR0B, SIM_TCNT0, SIM_OCR0A, SIM_OCR0B, SIM_TIMSK0, SIM_TIFR0,
+	SIM_TCCR1A, SIM_TCCR1B, SIM_TCCR1C, SIM_TCNT1, SIM_OCR1A, SIM_OCR1B, SIM_TIMSK1, SIM_TIFR1,
+	SIM_UCSR0A, SIM_UCSR0B, SIM_UCSR0C, SIM_UBRR0, SIM_UDR0,
+	SIM_UCSR1A, SIM_UCSR1B, SIM_UCSR1C, SIM_UBRR1, SIM_UDR1,
+	SIM_NUM_REGS
+};
+
+volatile void *sim_io(uint8_t reg);
+
+#define SIM_REG8(r)			(*(volatile uint8_t *)sim_io(r))
+#define SIM_REG16(r)		(*(volatile uint16_t *)sim_io(r))
+// UDRn and TCNT1 carry a marker above the register width so that a write
+//  can be told apart from a read even when the same value is written back.
+#define SIM_REG_UDR(r)		(*(volatile uint16_t *)sim_io(r))
+#define SIM_REG_TCNT(r)		(*(volatile uint32_t *)sim_io(r))
+
+#define PINA		SIM_REG8(SIM_PINA)
+#define DDRA		SIM_REG8(SIM_DDRA)
+#define PORTA		SIM_REG8(SIM_PORTA)
+#define PINB		SIM_REG8(SIM_PINB)
+#define DDRB		SIM_REG8(SIM_DDRB)
+#define PORTB		SIM_REG8(SIM_PORTB)
+#define PINC		SIM_REG8(SIM_PINC)
+#define DDRC		SIM_REG8(SIM_DDRC)
+#define PORTC		SIM_REG8(SIM_PORTC)
+#define PIND		SIM_REG8(SIM_PIND)
+#define DDRD		SIM_REG8(SIM_DDRD)
+#define PORTD		SIM_REG8(SIM_PORTD)
+
+#define MCUSR		SIM_REG8(SIM_MCUSR)
+#define WDTCSR		SIM_REG8(SIM_WDTCSR)
+#define SMCR		SIM_REG8(SIM_SMCR)
+#define SREG		SIM_REG8(SIM_SREG)
+
+#define PCICR		SIM_REG8(SIM_PCICR)
+#define PCIFR		SIM_REG8(SIM_PCIFR)
+#define PCMSK0		SIM_REG8(SIM_PCMSK0)
+#define PCMSK1		SIM_REG8(SIM_PCMSK1)
+#define PCMSK2		SIM_REG8(SIM_PCMSK2)
+#define PCMSK3		SIM_REG8(SIM_PCMSK3)
+
+#define TCCR0A		SIM_REG8(SIM_TCCR0A)
+#define TCCR0B		SIM_REG8(SIM_TCCR0B)
+#define TCNT0		SIM_REG8(SIM_TCNT0)
+#define OCR0A		SIM_REG8(SIM_OCR0A)
+#define OCR0B		SIM_REG8(SIM_OCR0B)
+#define TIMSK0		SIM_REG8(SIM_TIMSK0)
+#define TIFR0		SIM_REG8(SIM_TIFR0)
+
+#define TCCR1A		SIM_REG8(SIM_TCCR1A)
+#define TCCR1B		SIM_REG8(SIM_TCCR1B)
+#define TCCR1C		SIM_REG8(SIM_TCCR1C)
+#define TCNT1		SIM_REG_TCNT(SIM_TCNT1)
+#define OCR1A		SIM_REG16(SIM_OCR1A)
+#define OCR1B		SIM_REG16(SIM_OCR1B)
+#define TIMSK1		SIM_REG8(SIM_TIMSK1)
+#define TIFR1		SIM_REG8(SIM_TIFR1)
+
+#define UCSR0A		SIM_REG8(SIM_UCSR0A)
+#define UCSR0B		SIM_REG8(SIM_UCSR0B)
+#define UCSR0C		SIM_REG8(SIM_UCSR0C)
+#define UBRR0		SIM_REG16(SIM_UBRR0)
+#define UBRR0L		(((volatile uint8_t *)sim_io(SIM_UBRR0))[0])
+#define UBRR0H		(((volatile uint8_t *)sim_io(SIM_UBRR0))[1])
+#define UDR0		SIM_REG_UDR(SIM_UDR0)
+
+#define UCSR1A		SIM_REG8(SIM_UCSR1A)
+#define UCSR1B		SIM_REG8(SIM_UCSR1B)
+#define UCSR1C		SIM_REG8(SIM_UCSR1C)
+#define UBRR1		SIM_REG16(SIM_UBRR1)
+#define UBRR1L		(((volatile uint8_t *)sim_io(SIM_UBRR1))[0])
+#define UBRR1H		(((volatile uint8_t *)sim_io(SIM_UBRR1))[1])
+#define UDR1		SIM_REG_UDR(SIM_UDR1)
+
+#ifndef _BV
+#define _BV(bit)	(1 << (bit))
+#endif
+
+// Port pins
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define DDA0 0
+#define DDB0 0
+#define DDD0 0
+#define DDD7 7
+
+// MCUSR
+#define JTRF	4
+#define WDRF	3
+#define BORF	2
+#define EXTRF	1
+#define PORF	0
+
+// WDTCSR
+#define WDIF	7
+#define WDIE	6
+#define WDP3	5
+#define WDCE	4
+#define WDE		3
+#define WDP2	2
+#define WDP1	1
+#define WDP0	0
+
+// SMCR
+#define SM2		3
+#define SM1		2
+#define SM0		1
+#define SE		0
+
+// Pin change interrupts
+#define PCIE3	3
+#define PCIE2	2
+#define PCIE1	1
+#define PCIE0	0
+#define PCIF3	3
+#define PCIF2	2
+#define PCIF1	1
+#define PCIF0	0
+#define PCINT24	0
+#define PCINT25	1
+#define PCINT26	2
+#define PCINT27	3
+
+// Timer0
+#define COM0A1	7
+#define COM0A0	6
+#define WGM01	1
+#define WGM00	0
+#define WGM02	3
+#define CS02	2
+#define CS01	1
+#define CS00	0
+#define OCIE0B	2
+#define OCIE0A	1
+#define TOIE0	0
+#define OCF0B	2
+#define OCF0A	1
+#define TOV0	0
+
+// Timer1
+#define WGM13	4
+#define WGM12	3
+#define CS12	2
+#define CS11	1
+#define CS10	0
+#define ICIE1	5
+#define OCIE1B	2
+#define OCIE1A	1
+#define TOIE1	0
+#define ICF1	5
+#define OCF1B	2
+#define OCF1A	1
+#define TOV1	0
+
+// USART0
+#define RXC0	7
+#define TXC0	6
+#define UDRE0	5
+#define FE0		4
+#define DOR0	3
+#define UPE0	2
+#define U2X0	1
+#define MPCM0	0
+#define RXCIE0	7
+#define TXCIE0	6
+#define UDRIE0	5
+#define RXEN0	4
+#define TXEN0	3
+#define UCSZ02	2
+#define RXB80	1
+#define TXB80	0
+#define UMSEL01	7
+#define UMSEL00	6
+#define UPM01	5
+#define UPM00	4
+#define USBS0	3
+#define UCSZ01	2
+#define UCSZ00	1
+#define UCPOL0	0
+
+// USART1
+#define RXC1	7
+#define TXC1	6
+#define UDRE1	5
+#define FE1		4
+#define DOR1	3
+#define UPE1	2
+#define U2X1	1
+#define MPCM1	0
+#define RXCIE1	7
+#define TXCIE1	6
+#define UDRIE1	5
+#define RXEN1	4
+#define TXEN1	3
+#define UCSZ12	2
+#define RXB81	1
+#define TXB81	0
+#define UMSEL11	7
+#define UMSEL10	6
+#define UPM11	5
+#define UPM10	4
+#define USBS1	3
+#define UCSZ11	2
+#define UCSZ10	1
+#define UCPOL1	0
+
+// Interrupt vectors. ISR(x) defines a plain function; the simulator calls
+//  the ones that exist (weak references) in ATmega644P priority order.
+#define PCINT3_vect			sim_vect_PCINT3
+#define TIMER1_COMPA_vect	sim_vect_TIMER1_COMPA
+#define TIMER0_COMPA_vect	sim_vect_TIMER0_COMPA
+#define TIMER0_OVF_vect		sim_vect_TIMER0_OVF
+#define USART0_RX_vect		sim_vect_USART0_RX
+#define USART0_UDRE_vect	sim_vect_USART0_UDRE
+#define USART0_TX_vect		sim_vect_USART0_TX
+#define USART1_RX_vect		sim_vect_USART1_RX
+#define USART1_UDRE_vect	sim_vect_USART1_UDRE
+#define USART1_TX_vect		sim_vect_USART1_TX
+#define BADISR_vect			sim_vect_BADISR
+
+#endif
@@ -0,0 +1,24 @@
+//*****************************************************************************
+//	Host replacement for <avr/pgmspace.h> - SDI-12 bridge simulator
+//
+//	Flash and RAM share one address space on the host.
+//*****************************************************************************
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <inttypes.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P					const char *
+#define PSTR(s)					(s)
+
+#define pgm_read_byte(addr)		(*(const uint8_t *)(addr))
+#define pgm_read_word(addr)		(*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)	(*(const uint32_t *)(addr))
+#define strcpy_P(dst, src)		strcpy((dst), (src))
+#define strlen_P(src)			strlen(src)
+#define memcpy_P(dst, src, n)	memcpy((dst), (src), (n))
+
+#endif
@@ -0,0 +1,21 @@
+//*****************************************************************************
+//	Host replacement for <avr/sleep.h> - SDI-12 bridge simulator
+//
+//	Only idle mode is modelled: sleep_cpu() lets virtual time run on to the
+//	 next interrupt and takes it, as the target does when an enabled
+//	 interrupt wakes it.
+//*****************************************************************************
+
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+void sim_sleep(void);
+
+#define SLEEP_MODE_IDLE		0
+
+#define set_sleep_mode(m)	do { (void)(m); } while (0)
+#define sleep_enable()		do { } while (0)
+#define sleep_disable()		do { } while (0)
+#define sleep_cpu()			sim_sleep()
+
+#endif
@@ -0,0 +1,18 @@
+//*****************************************************************************
+//	Host replacement for <avr/wdt.h> - SDI-12 bridge simulator
+//
+//	The watchdog is not modelled; the calls compile to nothing.
+//*****************************************************************************
+
+#ifndef SIM_AVR_WDT_H
+#define SIM_AVR_WDT_H
+
+#define WDTO_15MS	0
+#define WDTO_120MS	3
+#define WDTO_1S		6
+
+#define wdt_reset()			do { } while (0)
+#define wdt_disable()		do { } while (0)
+#define wdt_enable(t)		do { (void)(t); } while (0)
+
+#endif
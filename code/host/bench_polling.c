@@ -0,0 +1,167 @@
+//*****************************************************************************
+//	Polling throughput benchmark - SDI-12 bridge simulator
+//
+//	Runs the firmware against 1..62 simulated nodes (one process per node
+//	 count) and reports the time from the end of the network-awake delay
+//	 (kWSN_StatSampling, or kWSN_StatPipeProbesOn when SAMPLING_PIPELINED)
+//	 to kWSN_StatDoneSampling in the first wake cycle, i.e. how long the
+//	 bridge needs to poll the whole network, against the WAKE_TIME it has.
+//
+//	The network is kept awake until polling finishes so the full span is
+//	 measured even when it overruns WAKE_TIME. Node addresses come from a
+//	 4-bit DIP switch, so above 16 nodes addresses repeat: nodes[] entries
+//	 alias and the same radio is polled more than once. Every node has the
+//	 same link parameters, so the span still scales as for distinct nodes.
+//
+//	Built with NODE_ARRAY_SIZE=64 so the node tables hold the whole network.
+//
+//	Each run also counts the samples the firmware stored and the requests
+//	 that timed out. A run that stores fewer samples than it has nodes, or
+//	 fails a node it discovered, fails the benchmark (exit status 1),
+//	 however fast it was. With latency (-h, -l) and more than REQ_SLOTS
+//	 nodes, that checks initialization keeps within the request table.
+//
+//	Usage: bench_polling [-n first last] [-h hops] [-l hop_ms] [-p loss]
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "xbee_net.h"
+#include "../main.h"
+#include "../nodes.h"
+
+#define BENCH_MAX_NODES			62
+
+typedef struct
+{
+	uint8_t		nodes;
+	uint8_t		discovered;
+	uint8_t		initialized;
+	uint16_t	samples;					// stored, all nodes
+	uint16_t	timeouts;					// requests gone unanswered, all nodes
+	bool		done;
+	uint64_t	span;
+} _bench_result;
+
+extern volatile uint8_t state;
+
+static _bench_result	result;
+static uint64_t			sampling_start;
+static bool				awake_seen;
+
+static void watch_polling(void *ctx)
+{
+	(void)ctx;
+	if ( state == kWSN_StatBeforeSampling )
+		awake_seen = true;
+	else if ( awake_seen && !sampling_start &&
+			(state == kWSN_StatSampling || state == kWSN_StatPipeProbesOn) )
+		sampling_start = sim_now();
+	else if ( sampling_start && state == kWSN_StatDoneSampling )  {
+		result.span = sim_now() - sampling_start;
+		result.done = true;
+		sim_stop();
+	}
+}
+
+static void run_one(uint8_t n, uint8_t hops, uint16_t hop_ms, float loss, int fd)
+{
+	_xbee_net_cfg net = { n, 13000, 3, 3, 40, true };
+	_xbee_node_cfg node = { 0x0013A200, 0, 0, hops, hop_ms, loss, { 512, 600 } };
+	uint8_t i;
+
+	xbee_net_init(&net);
+	for ( i = 0; i < n; i++ )  {
+		node.SL = 0x40B00000UL + i;
+		node.dip = i % 16;
+		xbee_net_add(&node);
+	}
+	sim_watch(watch_polling, NULL);
+
+	// start-up and discovery, about 1 s of setup per node, one sleep period
+	//  and a generous 10 s of polling per node
+	sim_run( SIM_MS(40000ULL + n * 11000ULL) );
+
+	result.nodes = n;
+	result.discovered = number_of_nd_nodes;
+	result.initialized = number_of_nodes;
+	// aliased addresses share an entry, and so add up there
+	for ( i = 0; i < NODE_ARRAY_SIZE; i++ )  {
+		result.samples += nodes[i].probe[0].stored;
+		result.timeouts += nodes[i].UART_timeouts;
+	}
+	if ( write(fd, &result, sizeof(result)) != sizeof(result) )
+		_exit(1);
+	_exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	int first = 1, last = BENCH_MAX_NODES, hops = 1, hop_ms = 15, i, n, fd[2], status, short_runs = 0;
+	float loss = 0;
+	_bench_result r;
+	pid_t pid;
+
+	for ( i = 1; i < argc; i++ )  {
+		if ( !strcmp(argv[i], "-n") && i + 2 < argc )  {
+			first = atoi(argv[++i]);
+			last = atoi(argv[++i]);
+		}
+		else if ( !strcmp(argv[i], "-h") && i + 1 < argc )
+			hops = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "-l") && i + 1 < argc )
+			hop_ms = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "-p") && i + 1 < argc )
+			loss = (float)atof(argv[++i]);
+		else  {
+			fprintf(stderr, "usage: %s [-n first last] [-h hops] [-l hop_ms] [-p loss]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ( first < 1 )
+		first = 1;
+	if ( last > BENCH_MAX_NODES )
+		last = BENCH_MAX_NODES;
+
+	printf("# %s sampling, hops %d, %d ms per hop, loss %.2f, WAKE_TIME %u ms\n",
+		SAMPLING_PIPELINED ? "pipelined" : "serial", hops, hop_ms, loss, WAKE_TIME);
+	printf("# nodes,discovered,initialized,samples,timeouts,polling_ms,ms_per_node,fits_wake_time\n");
+	for ( n = first; n <= last; n++ )  {
+		if ( pipe(fd) )  {
+			perror("pipe");
+			return 1;
+		}
+		fflush(stdout);
+		pid = fork();
+		if ( pid < 0 )  {
+			perror("fork");
+			return 1;
+		}
+		if ( pid == 0 )  {
+			close(fd[0]);
+			run_one( (uint8_t)n, (uint8_t)hops, (uint16_t)hop_ms, loss, fd[1] );
+		}
+		close(fd[1]);
+		memset(&r, 0, sizeof(r));
+		if ( read(fd[0], &r, sizeof(r)) != sizeof(r) )
+			r.nodes = (uint8_t)n;
+		close(fd[0]);
+		waitpid(pid, &status, 0);
+
+		if ( r.samples < n || r.initialized < r.discovered )
+			short_runs++;
+		printf("%d,%u,%u,%u,%u,", n, r.discovered, r.initialized, r.samples, r.timeouts);
+		if ( r.done )
+			printf("%.1f,%.1f,%s\n", SIM_TO_US(r.span) / 1000.0, SIM_TO_US(r.span) / 1000.0 / r.initialized,
+				SIM_TO_US(r.span) / 1000.0 <= WAKE_TIME ? "yes" : "no");
+		else
+			printf(",,no\n");
+	}
+	printf("# %d runs, %d with fewer samples than nodes or a node failed: %s\n", last - first + 1, short_runs,
+		short_runs ? "FAIL" : "PASS");
+	return short_runs ? 1 : 0;
+}
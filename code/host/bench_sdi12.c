@@ -0,0 +1,156 @@
+//*****************************************************************************
+//	SDI-12 response timing benchmark - SDI-12 bridge simulator
+//
+//	A simulated data logger issues a rotating set of commands to the bridge
+//	 at a fixed interval from the moment the firmware enables its SDI-12
+//	 port (network initialized) while it sleeps and polls a simulated
+//	 network, so commands land in every state the WSN state machine goes
+//	 through in operation. Each exchange is written as a CSV line with the
+//	 time from the end of the command to the first and last response byte,
+//	 and checked against the SDI-12 rules:
+//		- every command is answered
+//		- the response starts within 15 ms of the command's stop bit
+//		- the service request after aM! arrives within the promised ttt
+//	The bench exits 1 when any check fails.
+//
+//	Usage: bench_sdi12 [-n nodes] [-i interval_ms] [-t end_ms]
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "xbee_net.h"
+#include "sdi12_logger.h"
+#include "../main.h"
+
+#define BENCH_MAX_STATES		4096
+
+extern volatile uint8_t state;
+extern bool initialized;
+
+static uint64_t	state_time[BENCH_MAX_STATES];
+static uint8_t	state_value[BENCH_MAX_STATES];
+static uint16_t	state_count;
+
+static int		bench_nodes = 3, bench_interval = 2500;
+static double	bench_end_ms = 90000;
+static uint64_t	sdi12_up;
+
+// The logger starts once the bridge answers on SDI-12
+static void start_logger(void)
+{
+	static const char *commands[] = { "?!", "%cI!", "%cM!", "%cMC!", "%cC!", "%cCC!" };
+	char cmd[12];
+	int i;
+
+	sdi12_up = sim_now();
+	for ( i = 0; SIM_TO_US(sdi12_up) / 1000.0 + (double)(i + 1) * bench_interval < bench_end_ms; i++ )  {
+		snprintf(cmd, sizeof(cmd), commands[i % 6], '1' + (i / 6) % bench_nodes);
+		sdi12_logger_command( sdi12_up + SIM_MS((uint64_t)(i + 1) * bench_interval), cmd );
+	}
+}
+
+static void watch_states(void *ctx)
+{
+	(void)ctx;
+	if ( initialized && !sdi12_up )
+		start_logger();
+	if ( state_count && state_value[state_count - 1] == state )
+		return;
+	if ( state_count < BENCH_MAX_STATES )  {
+		state_time[state_count] = sim_now();
+		state_value[state_count] = state;
+		state_count++;
+	}
+}
+
+static int state_at(uint64_t t)
+{
+	int i;
+
+	for ( i = state_count - 1; i >= 0; i-- )
+		if ( state_time[i] <= t )
+			return state_value[i];
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	int i, late = 0, srq_late = 0, answered = 0;
+	double first_ms, last_ms, worst = 0;
+	_xbee_node_cfg node = { 0x0013A200, 0, 0, 1, 15, 0, { 512, 600 } };
+	const _sdi12_exchange *ex;
+	uint16_t n;
+	bool ok, pass;
+
+	for ( i = 1; i < argc; i++ )  {
+		if ( !strcmp(argv[i], "-n") && i + 1 < argc )
+			bench_nodes = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "-i") && i + 1 < argc )
+			bench_interval = atoi(argv[++i]);
+		else if ( !strcmp(argv[i], "-t") && i + 1 < argc )
+			bench_end_ms = atof(argv[++i]);
+		else  {
+			fprintf(stderr, "usage: %s [-n nodes] [-i interval_ms] [-t end_ms]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ( bench_nodes < 1 || bench_nodes > 9 || bench_interval < 100 )  {
+		fprintf(stderr, "bench_sdi12: 1..9 nodes, interval of at least 100 ms\n");
+		return 2;
+	}
+
+	xbee_net_init(NULL);
+	for ( i = 0; i < bench_nodes; i++ )  {
+		node.SL = 0x40C00001UL + i;
+		node.dip = (uint8_t)(i + 1);
+		xbee_net_add(&node);
+	}
+	sdi12_logger_init(0, 0);
+	sim_watch(watch_states, NULL);
+	sim_run( SIM_US(bench_end_ms * 1000.0) );
+
+	printf("t_ms,wsn_state,command,response,first_byte_ms,last_byte_ms,ttt_s,srq_s,ok\n");
+	ex = sdi12_logger_exchanges(&n);
+	for ( i = 0; i < n; i++ )  {
+		printf("%.3f,%d,%s,", SIM_TO_US(ex[i].cmd_end) / 1000.0, state_at(ex[i].cmd_end), ex[i].cmd);
+		if ( !ex[i].answered )  {
+			printf(",,,,,\n");
+			continue;
+		}
+		answered++;
+		first_ms = SIM_TO_US(ex[i].first - ex[i].cmd_end) / 1000.0;
+		last_ms = SIM_TO_US(ex[i].last - ex[i].cmd_end) / 1000.0;
+		ok = first_ms <= SDI12_RESPONSE_MAX_MS;
+		if ( !ok )
+			late++;
+		if ( first_ms > worst )
+			worst = first_ms;
+		printf("\"%s\",%.3f,%.3f,", ex[i].resp, first_ms, last_ms);
+		if ( ex[i].ttt >= 0 )
+			printf("%d,", ex[i].ttt);
+		else
+			printf(",");
+		if ( ex[i].srq )  {
+			printf("%.3f,", SIM_TO_US(ex[i].srq - ex[i].cmd_end) / 1e6);
+			if ( SIM_TO_US(ex[i].srq - ex[i].cmd_end) / 1e6 > ex[i].ttt )  {
+				srq_late++;
+				ok = false;
+			}
+		}
+		else
+			printf(",");
+		printf("%s\n", ok ? "yes" : "no");
+	}
+
+	pass = sdi12_up && n && answered == n && !late && !srq_late;
+	if ( sdi12_up )
+		printf("# SDI-12 enabled at %.3f ms\n", SIM_TO_US(sdi12_up) / 1000.0);
+	else
+		printf("# SDI-12 never enabled\n");
+	printf("# %u commands, %d answered, worst first byte %.3f ms (limit %.0f ms), "
+		"%d late responses, %d late service requests: %s\n", n, answered, worst,
+		SDI12_RESPONSE_MAX_MS, late, srq_late, pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+//*****************************************************************************
+//	Rolling statistics benchmark - SDI-12 bridge simulator
+//
+//	Feeds a fixed pseudo-random sequence of 10-bit samples through
+//	 node_add_sample on both probes of one node, changing the window with
+//	 node_set_window along the way (shrinking it, growing it, down to one
+//	 sample and back, before and after the buffer fills) and planting
+//	 extremes so that min and max leave the window and are rescanned.
+//	 After every sample the mean, standard deviation, range, EMA and last
+//	 sample are checked against a recomputation over the same window from
+//	 the sequence itself. Then times one sample added and its statistics
+//	 read against summing the window afresh, as node_calculate_average
+//	 used to.
+//
+//	Usage: bench_stats [-n samples] [-r rounds]
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../main.h"
+#include "../nodes.h"
+
+#define BENCH_NODE				1
+#define BENCH_MAX_SAMPLES		4096
+
+typedef struct
+{
+	uint32_t	at;						// before this sample
+	uint8_t		window;
+} _window_change;
+
+static const _window_change changes[] =
+{
+	{    5,  4 },						// buffer not yet full
+	{   12, 16 },
+	{   40,  5 },
+	{   60,  1 },
+	{   70,  9 },
+	{  100, 16 },
+	{  300,  3 },
+	{  333, 16 },
+	{  500, 12 },
+};
+#define CHANGE_COUNT			(sizeof(changes) / sizeof(changes[0]))
+
+static uint16_t	seq[2][BENCH_MAX_SAMPLES];
+static double	ema_ref[2];
+static int		checks, bad;
+
+static uint16_t next_sample(uint32_t i, uint8_t probe)
+{
+	// extremes now and then, held for a few samples so they are evicted
+	//  in a run and the rescan has to find the next one
+	if ( i % 37 < 3 )
+		return probe ? 0 : SAMPLE_MAX;
+	if ( i % 53 < 2 )
+		return probe ? SAMPLE_MAX : 0;
+	return (uint16_t)(rand() % (SAMPLE_MAX + 1));
+}
+
+static uint32_t isqrt(uint64_t v)
+{
+	uint64_t r = 0;
+
+	while ( (r + 1) * (r + 1) <= v )
+		r++;
+	return (uint32_t)r;
+}
+
+static void check(uint32_t i, uint8_t probe, const char *what, long got, long want)
+{
+	checks++;
+	if ( got == want )
+		return;
+	if ( bad++ < 10 )
+		printf("# sample %u probe %u window %u: %s %ld, expected %ld\n",
+			i, probe, node_window, what, got, want);
+}
+
+// Statistics over the last min(i + 1, window) samples of the sequence
+static void check_probe(uint32_t i, uint8_t probe)
+{
+	uint32_t n = i + 1 < node_window ? i + 1 : node_window, k;
+	uint64_t sum = 0, sum_sq = 0;
+	uint16_t v, lo = SAMPLE_MAX, hi = 0;
+
+	for ( k = 0; k < n; k++ )  {
+		v = seq[probe][i - k];
+		sum += v;
+		sum_sq += (uint64_t)v * v;
+		if ( v < lo )
+			lo = v;
+		if ( v > hi )
+			hi = v;
+	}
+	check(i, probe, "count", nodes[BENCH_NODE].probe[probe].count, n);
+	check(i, probe, "mean", node_calculate_average(BENCH_NODE, probe), sum / n);
+	check(i, probe, "stddev", node_stddev(BENCH_NODE, probe), n < 2 ? 0 : isqrt(n * sum_sq - sum * sum) / n);
+	check(i, probe, "range", node_range(BENCH_NODE, probe), hi - lo);
+	check(i, probe, "last", node_last_sample(BENCH_NODE, probe), seq[probe][i]);
+	// each update truncates up to one fraction step, which decays by
+	//  7/8 a sample and so adds up to under one count, and reading it
+	//  out truncates another
+	check(i, probe, "ema off by more than 2",
+		labs((long)node_ema(BENCH_NODE, probe) - (long)(ema_ref[probe] + 0.5)) > 2, 0);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	volatile uint32_t sink = 0;
+	long rounds = 2000000, r;
+	uint32_t samples = 1000, i, c = 0;
+	double t0, rolling_ns, rescan_ns;
+	uint8_t probe, k;
+	_probe *p;
+
+	for ( i = 1; i < (uint32_t)argc; i++ )  {
+		if ( !strcmp(argv[i], "-n") && i + 1 < (uint32_t)argc )
+			samples = (uint32_t)atol(argv[++i]);
+		else if ( !strcmp(argv[i], "-r") && i + 1 < (uint32_t)argc )
+			rounds = atol(argv[++i]);
+		else  {
+			fprintf(stderr, "usage: %s [-n samples] [-r rounds]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ( samples < 1 || samples > BENCH_MAX_SAMPLES )  {
+		fprintf(stderr, "bench_stats: 1..%d samples\n", BENCH_MAX_SAMPLES);
+		return 2;
+	}
+
+	srand(1);
+	for ( i = 0; i < samples; i++ )  {
+		// a new window is built from the samples kept, so it can only
+		//  reach as far back as the buffer does
+		if ( c < CHANGE_COUNT && changes[c].at == i )
+			node_set_window( changes[c++].window );
+		for ( probe = 0; probe < 2; probe++ )  {
+			seq[probe][i] = next_sample(i, probe);
+			node_add_sample( BENCH_NODE, probe, seq[probe][i] );
+			ema_ref[probe] = i ? ema_ref[probe] + (seq[probe][i] - ema_ref[probe]) / (1 << NODE_EMA_SHIFT)
+				: seq[probe][i];
+			check_probe(i, probe);
+		}
+	}
+
+	// steady state: a full window of DATA_BUFFER_SIZE
+	node_set_window(DATA_BUFFER_SIZE);
+	t0 = now_ns();
+	for ( r = 0; r < rounds; r++ )  {
+		node_add_sample( BENCH_NODE, 0, (uint16_t)(r & SAMPLE_MAX) );
+		sink += node_calculate_average(BENCH_NODE, 0) + node_stddev(BENCH_NODE, 0) + node_range(BENCH_NODE, 0);
+	}
+	rolling_ns = (now_ns() - t0) / rounds;
+
+	p = &nodes[BENCH_NODE].probe[0];
+	t0 = now_ns();
+	for ( r = 0; r < rounds; r++ )  {
+		p->data[r % DATA_BUFFER_SIZE] = (uint16_t)(r & SAMPLE_MAX);
+		for ( i = 0, k = 0; k < DATA_BUFFER_SIZE; k++ )
+			i += p->data[k];
+		sink += i / DATA_BUFFER_SIZE;
+	}
+	rescan_ns = (now_ns() - t0) / rounds;
+
+	printf("method,ns_per_sample\n");
+	printf("rolling_mean_stddev_range,%.2f\n", rolling_ns);
+	printf("window_sum_mean_only,%.2f\n", rescan_ns);
+	printf("# %u samples, %u window changes, %d checks, %d mismatches: %s\n",
+		samples, c, checks, bad, bad ? "FAIL" : "PASS");
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,479 @@
+//*****************************************************************************
+//	Scripted driver for the SDI-12 bridge host simulator
+//
+//	Runs the unmodified bridge firmware against a script of timed stimuli and
+//	 reports what it did: WSN state transitions, frames sent to the XBee,
+//	 SDI-12 responses, the LCD, and time spent in each interrupt handler.
+//
+//	Script lines (times in ms from reset, '#' starts a comment):
+//		<ms> xbee  <hex bytes>	API frame data from the XBee; the start
+//								 delimiter, length and checksum are added
+//		<ms> xraw  <hex bytes>	bytes on the XBee serial line exactly as
+//								 given: broken or truncated framing
+//		<ms> line  0|1			drive the SDI-12 data line (PD0)
+//		<ms> sdi12 <command>	command from the simulated data logger
+//								 (see sdi12_logger.h); measurements
+//								 continue through SRQ and aD0!
+//		node <SH> <SL> [dip=n] [hops=n] [hop_ms=n] [loss=p] [adc=a,b]
+//								remote node answering ND and remote AT
+//								 commands (see xbee_net.h); with any node
+//								 lines the simulated coordinator replaces
+//								 scripted xbee frames
+//
+//	Each energy ledger cycle (network asleep to network asleep) is reported
+//	 with its charge per load; -b gives the battery capacity in mAh used to
+//	 turn the mean charge per cycle into battery days.
+//
+//	-e keeps EEPROM in a file: it is loaded before the run, if it exists, and
+//	 saved after it, so running twice starts the second run warm.
+//
+//	Exits 1 if a command from the data logger went unanswered.
+//
+//	Usage: bridge_sim [-t end_ms] [-q] [-b mAh] [-e eeprom_file] script
+//*****************************************************************************
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "dogm.h"
+#include "xbee_net.h"
+#include "sdi12_logger.h"
+#include "../main.h"
+#include "../energy.h"
+#include "../uart.h"
+#include "../wireless_xbee.h"
+#include "../nodes.h"
+
+#define XBEE_FRAME_MAX			128
+
+typedef struct
+{
+	uint8_t		data[XBEE_FRAME_MAX];
+	uint16_t	len;
+	uint64_t	start;
+	bool		raw;						// data is sent as is, no framing added
+} _frame;
+
+extern volatile uint8_t state;
+
+static bool		quiet;
+static bool		network;
+static uint8_t	last_state = 0xFF;
+
+static _frame	xbee_tx;
+static uint32_t	xbee_tx_frames;
+
+static uint16_t	energy_seen;
+static uint64_t	energy_total_nAh, energy_total_ticks;
+static uint16_t	energy_counted;
+
+static uint64_t	wake_start;
+static uint32_t	wake_cycles;
+static uint64_t	wake_total, wake_worst;
+
+static const char *state_name(uint8_t s)
+{
+	static const char *names[] =
+	{
+		"Uninitialized", "MessageWaiting", "WaitingForMessage", "Asleep",
+		"BeforeSampling", "Warmup", "Sampling", "DoneSampling", "ProbesOn",
+		"ProbeWarmup", "ProbesOff", "?", "SampleReady", "NextNode",
+		"PacketError", "NodeDiscovery", "PipeProbesOn", "PipeWarmup",
+		"PipeSampling", "PipeCollect", "PipeProbesOff", "FrameDropped",
+		"Restored", "Startup", "DiscoveryDone",
+	};
+	return s < sizeof(names) / sizeof(names[0]) ? names[s] : "?";
+}
+
+static void print_time(uint64_t t)
+{
+	printf("%10.3f ms  ", SIM_TO_US(t) / 1000.0);
+}
+
+/*
+ * Observers
+ */
+
+static void watch_state(void *ctx)
+{
+	uint8_t s = state;
+	uint64_t d;
+
+	(void)ctx;
+	if ( s == last_state )
+		return;
+	if ( !quiet )  {
+		print_time( sim_now() );
+		printf("state %s -> %s\n", last_state == 0xFF ? "reset" : state_name(last_state), state_name(s));
+	}
+
+	if ( s == kWSN_StatBeforeSampling )
+		wake_start = sim_now();
+	else if ( s == kWSN_StatDoneSampling && wake_start )  {
+		d = sim_now() - wake_start;
+		wake_cycles++;
+		wake_total += d;
+		if ( d > wake_worst )
+			wake_worst = d;
+		wake_start = 0;
+		if ( !quiet )  {
+			print_time( sim_now() );
+			printf("wake cycle %.3f ms\n", SIM_TO_US(d) / 1000.0);
+		}
+	}
+	last_state = s;
+}
+
+static void watch_energy(void *ctx)
+{
+	const _energy_cycle *c = &energy_last;
+
+	(void)ctx;
+	if ( energy_cycles == energy_seen )
+		return;
+	energy_seen = energy_cycles;
+	// the first cycle includes start-up and is left out of the mean
+	if ( energy_cycles > 1 )  {
+		energy_total_nAh += c->total_nAh;
+		energy_total_ticks += c->ticks;
+		energy_counted++;
+	}
+	if ( quiet )
+		return;
+	print_time( sim_now() );
+	printf("energy cycle %u: %.3f s, %.6f mAh (radio %.6f, on %.3f s; mcu %.6f, on %.3f s; "
+		"probes %.6f, on %.3f s; lcd %.6f, %u us; idle %.3f s)\n", energy_cycles,
+		c->ticks * ENERGY_TICK_US / 1e6, c->total_nAh / 1e6,
+		c->load_nAh[ENERGY_RADIO] / 1e6, c->on_ticks[ENERGY_RADIO] * ENERGY_TICK_US / 1e6,
+		c->load_nAh[ENERGY_MCU] / 1e6, c->on_ticks[ENERGY_MCU] * ENERGY_TICK_US / 1e6,
+		c->load_nAh[ENERGY_PROBES] / 1e6, c->on_ticks[ENERGY_PROBES] * ENERGY_TICK_US / 1e6,
+		c->lcd_nAh / 1e6, c->lcd_us, c->idle_us / 1e6);
+}
+
+static void print_energy_summary(double battery_mAh)
+{
+	double mAh, cycle_s, days;
+
+	if ( !energy_counted )
+		return;
+	mAh = energy_total_nAh / 1e6 / energy_counted;
+	cycle_s = energy_total_ticks * ENERGY_TICK_US / 1e6 / energy_counted;
+	days = battery_mAh / (mAh * 86400.0 / cycle_s);
+	printf("energy: %u cycles after start-up, mean %.6f mAh per %.3f s cycle, "
+		"%.1f days on %.0f mAh\n", energy_counted, mAh, cycle_s, days, battery_mAh);
+}
+
+static void xbee_tx_byte(void *ctx, uint8_t byte, uint64_t start, uint64_t end)
+{
+	uint16_t i;
+
+	(void)ctx;
+	(void)end;
+	if ( xbee_tx.len == 0 && byte != 0x7E )
+		return;
+	if ( xbee_tx.len == 0 )
+		xbee_tx.start = start;
+	if ( xbee_tx.len < XBEE_FRAME_MAX )
+		xbee_tx.data[xbee_tx.len++] = byte;
+
+	if ( xbee_tx.len >= 3 && xbee_tx.len == ((xbee_tx.data[1] << 8) | xbee_tx.data[2]) + 4 )  {
+		xbee_tx_frames++;
+		if ( !quiet )  {
+			print_time( xbee_tx.start );
+			printf("xbee <-");
+			for ( i = 3; i < xbee_tx.len - 1; i++ )
+				printf(" %02X", xbee_tx.data[i]);
+			printf("\n");
+		}
+		xbee_tx.len = 0;
+	}
+}
+
+static void print_exchange(void *ctx, const _sdi12_exchange *ex)
+{
+	(void)ctx;
+	if ( quiet )
+		return;
+	print_time( ex->cmd_end );
+	printf("sdi12 %s", ex->cmd);
+	if ( !ex->answered )  {
+		printf(" -> no response\n");
+		return;
+	}
+	printf(" -> \"%s\"  first byte %.3f ms, last byte %.3f ms after command\n", ex->resp,
+		SIM_TO_US(ex->first - ex->cmd_end) / 1000.0, SIM_TO_US(ex->last - ex->cmd_end) / 1000.0);
+	if ( ex->ttt > 0 && !(ex->cmd[1] == 'C') )  {
+		print_time( ex->srq ? ex->srq : sim_now() );
+		if ( ex->srq )
+			printf("sdi12 service request %.3f s after command (ttt %d s)\n",
+				SIM_TO_US(ex->srq - ex->cmd_end) / 1e6, ex->ttt);
+		else
+			printf("sdi12 no service request within ttt %d s\n", ex->ttt);
+	}
+}
+
+/*
+ * Script events
+ */
+
+static void ev_line(void *ctx, uint32_t level)
+{
+	(void)ctx;
+	sim_pin_set( SIM_PORT_D, SIM_SDI12_RX_PIN, level != 0 );
+}
+
+static void ev_xbee(void *ctx, uint32_t arg)
+{
+	_frame *f = ctx;
+
+	(void)arg;
+	if ( !quiet )  {
+		uint16_t i;
+		print_time( sim_now() );
+		printf(f->raw ? "xraw ->" : "xbee ->");
+		for ( i = f->raw ? 0 : 3; i < (f->raw ? f->len : f->len - 1); i++ )
+			printf(" %02X", f->data[i]);
+		printf("\n");
+	}
+	sim_uart_rx_burst( SIM_UART_XBEE, sim_now(), f->data, f->len );
+}
+
+static _frame *frame_new(void)
+{
+	_frame *f = calloc(1, sizeof(*f));
+
+	if ( !f )  {
+		perror("bridge_sim");
+		exit(1);
+	}
+	return f;
+}
+
+static void script_xraw(uint64_t at, char *args, int lineno)
+{
+	_frame *f = frame_new();
+	unsigned v;
+	char *tok;
+
+	f->raw = true;
+	for ( tok = strtok(args, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n") )  {
+		if ( sscanf(tok, "%x", &v) != 1 || v > 0xFF || f->len >= XBEE_FRAME_MAX )  {
+			fprintf(stderr, "script line %d: bad byte '%s'\n", lineno, tok);
+			exit(1);
+		}
+		f->data[f->len++] = (uint8_t)v;
+	}
+	sim_schedule( at, ev_xbee, f, 0 );
+}
+
+static void script_xbee(uint64_t at, char *args, int lineno)
+{
+	_frame *f = frame_new();
+	uint8_t sum = 0;
+	uint16_t n = 0, i;
+	unsigned v;
+	char *tok;
+
+	f->data[0] = 0x7E;
+	for ( tok = strtok(args, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n") )  {
+		if ( sscanf(tok, "%x", &v) != 1 || v > 0xFF || n + 4 >= XBEE_FRAME_MAX )  {
+			fprintf(stderr, "script line %d: bad frame byte '%s'\n", lineno, tok);
+			exit(1);
+		}
+		f->data[3 + n++] = (uint8_t)v;
+	}
+	for ( i = 0; i < n; i++ )
+		sum += f->data[3 + i];
+	f->data[1] = (uint8_t)(n >> 8);
+	f->data[2] = (uint8_t)n;
+	f->data[3 + n] = 0xFF - sum;
+	f->len = n + 4;
+	sim_schedule( at, ev_xbee, f, 0 );
+}
+
+static void script_sdi12(uint64_t at, char *args)
+{
+	char *cmd = strtok(args, " \t\r\n");
+
+	if ( cmd )
+		sdi12_logger_command( at, cmd );
+}
+
+static void script_node(char *args, const char *path, int lineno)
+{
+	_xbee_node_cfg n = { 0 };
+	char *tok;
+	unsigned a, b;
+
+	n.SH = (uint32_t)strtoul(strtok(args, " \t\r\n") ?: "0", NULL, 16);
+	n.SL = (uint32_t)strtoul(strtok(NULL, " \t\r\n") ?: "0", NULL, 16);
+	while ( (tok = strtok(NULL, " \t\r\n")) )  {
+		if ( !strncmp(tok, "dip=", 4) )
+			n.dip = (uint8_t)atoi(tok + 4);
+		else if ( !strncmp(tok, "hops=", 5) )
+			n.hops = (uint8_t)atoi(tok + 5);
+		else if ( !strncmp(tok, "hop_ms=", 7) )
+			n.hop_ms = (uint16_t)atoi(tok + 7);
+		else if ( !strncmp(tok, "loss=", 5) )
+			n.loss = (float)atof(tok + 5);
+		else if ( sscanf(tok, "adc=%u,%u", &a, &b) == 2 )  {
+			n.adc[0] = (uint16_t)a;
+			n.adc[1] = (uint16_t)b;
+		}
+		else  {
+			fprintf(stderr, "%s:%d: unknown node option '%s'\n", path, lineno, tok);
+			exit(1);
+		}
+	}
+	network = true;
+	xbee_net_add(&n);
+}
+
+static void load_script(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	char line[512], cmd[16], *p;
+	double ms;
+	int lineno = 0, used;
+	uint64_t at;
+
+	if ( !fp )  {
+		perror(path);
+		exit(1);
+	}
+	while ( fgets(line, sizeof(line), fp) )  {
+		lineno++;
+		if ( (p = strchr(line, '#')) )
+			*p = 0;
+		used = 0;
+		if ( sscanf(line, " node %n", &used) == 0 && used > 0 )  {
+			script_node( line + used, path, lineno );
+			continue;
+		}
+		if ( sscanf(line, "%lf %15s %n", &ms, cmd, &used) < 2 )
+			continue;
+		at = SIM_US(ms * 1000.0);
+
+		if ( !strcmp(cmd, "xbee") )
+			script_xbee( at, line + used, lineno );
+		else if ( !strcmp(cmd, "xraw") )
+			script_xraw( at, line + used, lineno );
+		else if ( !strcmp(cmd, "line") )
+			sim_schedule( at, ev_line, NULL, (uint32_t)atoi(line + used) );
+		else if ( !strcmp(cmd, "sdi12") )
+			script_sdi12( at, line + used );
+		else  {
+			fprintf(stderr, "%s:%d: unknown command '%s'\n", path, lineno, cmd);
+			exit(1);
+		}
+	}
+	fclose(fp);
+}
+
+/*
+ * Report
+ */
+
+// False when a command went unanswered
+static bool print_sdi12_summary(void)
+{
+	uint16_t n, i, answered = 0, late = 0;
+	const _sdi12_exchange *ex = sdi12_logger_exchanges(&n);
+	uint64_t d, total = 0, worst = 0;
+
+	if ( !n )
+		return true;
+	for ( i = 0; i < n; i++ )  {
+		if ( !ex[i].answered )
+			continue;
+		answered++;
+		d = ex[i].first - ex[i].cmd_end;
+		total += d;
+		if ( d > worst )
+			worst = d;
+		if ( SIM_TO_US(d) > SDI12_RESPONSE_MAX_MS * 1000.0 )
+			late++;
+	}
+	printf("SDI-12: %u commands, %u answered", n, answered);
+	if ( answered )
+		printf(", first byte mean %.3f ms, worst %.3f ms, %u over %.0f ms",
+			SIM_TO_US(total / answered) / 1000.0, SIM_TO_US(worst) / 1000.0, late, SDI12_RESPONSE_MAX_MS);
+	printf("\n");
+	return answered == n;
+}
+
+static void print_isr(const char *name, uint32_t calls, uint64_t total, uint64_t worst)
+{
+	printf("  %-18s %8u calls  %10.1f us total  %8.2f us worst\n",
+		name, calls, SIM_TO_US(total), SIM_TO_US(worst));
+}
+
+int main(int argc, char **argv)
+{
+	double end_ms = 60000, battery_mAh = 2000;
+	const char *script = NULL, *eeprom = NULL;
+	uint64_t end;
+	bool sdi12_ok;
+	int i;
+
+	for ( i = 1; i < argc; i++ )  {
+		if ( !strcmp(argv[i], "-t") && i + 1 < argc )
+			end_ms = atof(argv[++i]);
+		else if ( !strcmp(argv[i], "-q") )
+			quiet = true;
+		else if ( !strcmp(argv[i], "-b") && i + 1 < argc )
+			battery_mAh = atof(argv[++i]);
+		else if ( !strcmp(argv[i], "-e") && i + 1 < argc )
+			eeprom = argv[++i];
+		else
+			script = argv[i];
+	}
+	if ( !script )  {
+		fprintf(stderr, "usage: %s [-t end_ms] [-q] [-b mAh] [-e eeprom_file] script\n", argv[0]);
+		return 2;
+	}
+
+	load_script(script);
+	if ( eeprom )
+		printf("EEPROM %s\n", sim_eeprom_load(eeprom) ? "loaded" : "erased");
+	if ( network )
+		xbee_net_init(NULL);
+	sim_watch(watch_state, NULL);
+	sim_watch(watch_energy, NULL);
+	sim_uart_tx_hook(SIM_UART_XBEE, xbee_tx_byte, NULL);
+	sdi12_logger_init(0, 0);
+	sdi12_logger_on_exchange(print_exchange, NULL);
+
+	end = sim_run( SIM_US(end_ms * 1000.0) );
+	if ( eeprom && !sim_eeprom_save(eeprom) )
+		perror(eeprom);
+
+	printf("\nstopped at %.3f ms, final state %s\n", SIM_TO_US(end) / 1000.0, state_name(state));
+	printf("LCD  [%s]\n     [%s]  %u controller writes\n", dogm_sim_row(0), dogm_sim_row(1), dogm_sim_writes());
+	printf("frames to XBee: %u, transmit queue high water %u of %u bytes\n", xbee_tx_frames,
+		UART1_tx_high_water, UART1_TX_BUFFER_SIZE - 1);
+	printf("frames from XBee dropped with all %u receive slots full: %u, given up part way: %u\n",
+		RX_FRAME_SLOTS, xbee_rx_overflows, xbee_rx_aborts);
+	printf("EEPROM: %u bytes written\n", sim_eeprom_writes());
+	if ( network )  {
+		const _xbee_net_stats *ns = xbee_net_stats();
+		printf("network: %u frames in (%u bad), %u out, %u attempts lost, %u TX failures, %u samples pushed\n",
+			ns->frames_in, ns->bad_frames, ns->frames_out, ns->lost, ns->failed, ns->pushed);
+	}
+	for ( i = 0; i < number_of_nodes; i++ )
+		printf("node %u: %u samples held, %u timeouts, %u retries, %u packet errors\n", node_ids[i],
+			nodes[node_ids[i]].probe[0].stored, nodes[node_ids[i]].UART_timeouts,
+			nodes[node_ids[i]].retries, nodes[node_ids[i]].Packet_errors);
+	if ( wake_cycles )
+		printf("wake cycle: %u complete, mean %.3f ms, worst %.3f ms\n", wake_cycles,
+			SIM_TO_US(wake_total / wake_cycles) / 1000.0, SIM_TO_US(wake_worst) / 1000.0);
+	sdi12_ok = print_sdi12_summary();
+	print_energy_summary(battery_mAh);
+	printf("mcu: asleep %.3f of %.3f s, awake %.2f%%\n", SIM_TO_US(sim_sleep_cycles()) / 1e6,
+		SIM_TO_US(sim_now()) / 1e6, 100.0 - 100.0 * sim_sleep_cycles() / sim_now());
+	printf("interrupt handlers:\n");
+	sim_isr_stats(print_isr);
+	return sdi12_ok ? 0 : 1;
+}
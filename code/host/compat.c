@@ -0,0 +1,36 @@
+//*****************************************************************************
+//	avr-libc extensions missing from the host C library
+//*****************************************************************************
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "compat.h"
+
+char *utoa(unsigned int value, char *str, int radix)
+{
+	char tmp[sizeof(unsigned int) * 8 + 1];
+	char *p = tmp, *out = str;
+
+	do  {
+		unsigned int d = value % radix;
+		*p++ = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+		value /= radix;
+	} while ( value );
+	while ( p > tmp )
+		*out++ = *--p;
+	*out = 0;
+	return str;
+}
+
+char *itoa(int value, char *str, int radix)
+{
+	// avr-libc: int is 16 bits there, so values are taken modulo 2^16
+	int16_t v = (int16_t)value;
+
+	if ( v < 0 && radix == 10 )  {
+		str[0] = '-';
+		utoa( (unsigned int)(-(int32_t)v), str + 1, radix );
+		return str;
+	}
+	return utoa( (uint16_t)v, str, radix );
+}
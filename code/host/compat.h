@@ -0,0 +1,12 @@
+//*****************************************************************************
+//	avr-libc extensions missing from the host C library. Included into every
+//	 firmware source by the host Makefile (-include compat.h).
+//*****************************************************************************
+
+#ifndef SIM_COMPAT_H
+#define SIM_COMPAT_H
+
+char *itoa(int value, char *str, int radix);
+char *utoa(unsigned int value, char *str, int radix);
+
+#endif
@@ -0,0 +1,28 @@
+//*****************************************************************************
+//	Header file for simulated DOGM 2x16 LCD - SDI-12 bridge simulator
+//
+//	Stands in for the display driver linked into the target build. Text is
+//	 kept in a 2x16 character array and each call busy-waits for roughly the
+//	 time the controller needs, so display traffic shows up in the timing.
+//*****************************************************************************
+
+#ifndef DOGM_H
+#define DOGM_H
+
+#include <inttypes.h>
+
+#define DOGM_ROWS			2
+#define DOGM_COLS			16
+
+void dogm_init(void);
+void dogm_clear(void);
+void dogm_gotoxy(uint8_t x, uint8_t y);
+void dogm_putc(char c);
+void dogm_puts(const char *s);
+
+// Simulator only: current display contents, one NUL-terminated row
+const char *dogm_sim_row(uint8_t y);
+// Simulator only: number of characters and commands sent to the controller
+uint32_t dogm_sim_writes(void);
+
+#endif
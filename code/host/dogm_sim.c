@@ -0,0 +1,68 @@
+//*****************************************************************************
+//	Simulated DOGM 2x16 LCD - SDI-12 bridge simulator
+//
+//	Timings follow the ST7036 datasheet: 26.3 us per character or cursor
+//	 command plus the SPI transfer, 1.08 ms for clear display.
+//*****************************************************************************
+
+#include <string.h>
+#include <util/delay.h>
+#include "dogm.h"
+
+#define DOGM_CHAR_US		30
+#define DOGM_CLEAR_US		1100
+#define DOGM_INIT_US		40000
+
+static char		dogm_text[DOGM_ROWS][DOGM_COLS + 1];
+static uint8_t	dogm_x, dogm_y;
+static uint32_t	dogm_writes;
+
+void dogm_init(void)
+{
+	_delay_us(DOGM_INIT_US);
+	dogm_clear();
+}
+
+void dogm_clear(void)
+{
+	memset(dogm_text, ' ', sizeof(dogm_text));
+	dogm_text[0][DOGM_COLS] = 0;
+	dogm_text[1][DOGM_COLS] = 0;
+	dogm_x = 0;
+	dogm_y = 0;
+	dogm_writes++;
+	_delay_us(DOGM_CLEAR_US);
+}
+
+void dogm_gotoxy(uint8_t x, uint8_t y)
+{
+	dogm_x = x;
+	dogm_y = y;
+	dogm_writes++;
+	_delay_us(DOGM_CHAR_US);
+}
+
+void dogm_putc(char c)
+{
+	if ( dogm_x < DOGM_COLS && dogm_y < DOGM_ROWS )
+		dogm_text[dogm_y][dogm_x] = c;
+	dogm_x++;
+	dogm_writes++;
+	_delay_us(DOGM_CHAR_US);
+}
+
+void dogm_puts(const char *s)
+{
+	while ( *s )
+		dogm_putc(*s++);
+}
+
+const char *dogm_sim_row(uint8_t y)
+{
+	return dogm_text[y < DOGM_ROWS ? y : 0];
+}
+
+uint32_t dogm_sim_writes(void)
+{
+	return dogm_writes;
+}
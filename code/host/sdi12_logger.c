@@ -0,0 +1,297 @@
+//*****************************************************************************
+//	Simulated SDI-12 data logger - SDI-12 bridge simulator
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "sdi12_logger.h"
+
+#define SDI12_BAUD				1200
+#define SDI12_BIT_CYCLES		((double)SIM_F_CPU / SDI12_BAUD)
+#define SDI12_FRAME_BITS		10			// start, 7 data, even parity, stop
+#define SDI12_TIMEOUT_MS		100			// no response by then: give up
+#define SDI12_SRQ_GRACE_MS		1000		// beyond ttt before giving up on SRQ
+#define SDI12_GAP_MS			20			// between one exchange and the next
+#define SDI12_QUEUE_SIZE		64
+
+enum
+{
+	PH_IDLE,			// nothing in progress
+	PH_RESPONSE,		// command sent, collecting the response
+	PH_SRQ,				// atttn received, waiting for the service request
+	PH_WAIT_TTT,		// concurrent measurement, waiting ttt seconds
+};
+
+static double			break_cycles, mark_cycles;
+static uint8_t			phase = PH_IDLE;
+static uint32_t			seq;							// invalidates stale timeouts
+
+static _sdi12_exchange	exchanges[SDI12_LOGGER_MAX_EXCHANGES];
+static uint16_t			exchange_count;
+static _sdi12_exchange	*cur;
+static char				line[SDI12_LOGGER_RESP_MAX];
+static uint8_t			line_len;
+static uint64_t			line_first;
+static char				d0_cmd[8];
+
+static char				*queue[SDI12_QUEUE_SIZE];
+static uint8_t			queue_head, queue_count;
+
+static void (*exchange_fn)(void *ctx, const _sdi12_exchange *ex);
+static void *exchange_ctx;
+
+static void next_command(void);
+
+/*
+ * Line driver
+ */
+
+static void ev_pin(void *ctx, uint32_t level)
+{
+	(void)ctx;
+	sim_pin_set( SIM_PORT_D, SIM_SDI12_RX_PIN, level != 0 );
+}
+
+static void ev_rx(void *ctx, uint32_t arg)
+{
+	(void)ctx;
+	sim_uart_rx( SIM_UART_SDI12, (uint8_t)arg, (uint8_t)(arg >> 8) );
+}
+
+static uint64_t bit_time(uint64_t start, uint32_t bit)
+{
+	return start + (uint64_t)(bit * SDI12_BIT_CYCLES + 0.5);
+}
+
+// Break, mark and characters of one command. Returns the end of the last stop bit.
+static uint64_t send_line(const char *cmd)
+{
+	uint64_t t = sim_now(), frame = (uint64_t)(SDI12_FRAME_BITS * SDI12_BIT_CYCLES + 0.5);
+	uint64_t brk_end = t + (uint64_t)break_cycles, f;
+	uint32_t bit = 0;
+	uint8_t c, level, prev = 1, b, bits[SDI12_FRAME_BITS];
+
+	// a USART left enabled sees the break as null characters with framing errors
+	sim_schedule( t, ev_pin, NULL, 0 );
+	for ( f = t + frame; f <= brk_end; f += frame )
+		sim_schedule( f, ev_rx, NULL, (uint32_t)SIM_RX_FE << 8 );
+	sim_schedule( brk_end, ev_pin, NULL, 1 );
+
+	t = brk_end + (uint64_t)mark_cycles;
+	for ( ; *cmd; cmd++ )  {
+		c = (uint8_t)*cmd & 0x7F;
+		bits[0] = 0;
+		bits[8] = 0;
+		for ( b = 0; b < 7; b++ )  {
+			bits[1 + b] = (c >> b) & 1;
+			bits[8] ^= bits[1 + b];
+		}
+		bits[9] = 1;
+		for ( b = 0; b < SDI12_FRAME_BITS; b++, bit++ )  {
+			level = bits[b];
+			if ( level != prev )
+				sim_schedule( bit_time(t, bit), ev_pin, NULL, level );
+			prev = level;
+		}
+		sim_schedule( bit_time(t, bit), ev_rx, NULL, c );
+	}
+	return bit_time(t, bit);
+}
+
+/*
+ * Exchanges
+ */
+
+static void ev_timeout(void *ctx, uint32_t arg);
+
+static void finish_exchange(void)
+{
+	if ( exchange_fn && cur )
+		exchange_fn( exchange_ctx, cur );
+}
+
+static void end_session(void)
+{
+	phase = PH_IDLE;
+	cur = NULL;
+	seq++;
+	next_command();
+}
+
+static void start_exchange(const char *cmd)
+{
+	if ( exchange_count < SDI12_LOGGER_MAX_EXCHANGES )
+		cur = &exchanges[exchange_count++];
+	else
+		cur = &exchanges[SDI12_LOGGER_MAX_EXCHANGES - 1];
+	memset(cur, 0, sizeof(*cur));
+	snprintf(cur->cmd, sizeof(cur->cmd), "%s", cmd);
+	cur->ttt = -1;
+	line_len = 0;
+	phase = PH_RESPONSE;
+	cur->cmd_end = send_line(cmd);
+	sim_schedule( cur->cmd_end + SIM_MS(SDI12_TIMEOUT_MS), ev_timeout, NULL, ++seq );
+}
+
+static void ev_send_d0(void *ctx, uint32_t arg)
+{
+	(void)ctx;
+	if ( arg == seq )
+		start_exchange(d0_cmd);
+}
+
+// aM!, aMC!, aMn!, aC!, aCC!, aCn! ... start a measurement session
+static bool is_measurement(const char *cmd, bool *concurrent)
+{
+	if ( strlen(cmd) < 3 || (cmd[1] != 'M' && cmd[1] != 'C') )
+		return false;
+	*concurrent = ( cmd[1] == 'C' );
+	return true;
+}
+
+static void response_line(uint64_t end)
+{
+	bool concurrent;
+	char ttt[4], n[3];
+
+	if ( phase == PH_SRQ )  {
+		cur->srq = line_first;
+		finish_exchange();
+		phase = PH_WAIT_TTT;
+		sim_schedule( sim_now() + SIM_MS(SDI12_GAP_MS), ev_send_d0, NULL, ++seq );
+		return;
+	}
+
+	cur->answered = true;
+	cur->first = line_first;
+	cur->last = end;
+	snprintf(cur->resp, sizeof(cur->resp), "%.*s", line_len >= 2 ? line_len - 2 : 0, line);
+
+	if ( !is_measurement(cur->cmd, &concurrent) || line_len < 6 )  {
+		finish_exchange();
+		end_session();
+		return;
+	}
+
+	memcpy(ttt, line + 1, 3);
+	ttt[3] = 0;
+	cur->ttt = (int16_t)atoi(ttt);
+	// atttn or atttnn: no values promised, nothing to collect
+	memcpy(n, line + 4, concurrent ? 2 : 1);
+	n[concurrent ? 2 : 1] = 0;
+	if ( atoi(n) == 0 )  {
+		finish_exchange();
+		end_session();
+		return;
+	}
+	snprintf(d0_cmd, sizeof(d0_cmd), "%cD0!", cur->cmd[0]);
+	seq++;
+	if ( !concurrent && cur->ttt > 0 )  {
+		// SRQ (aCRLF) is timed into the same exchange
+		phase = PH_SRQ;
+		sim_schedule( sim_now() + SIM_MS(cur->ttt * 1000ULL + SDI12_SRQ_GRACE_MS), ev_timeout, NULL, seq );
+	}
+	else  {
+		finish_exchange();
+		phase = PH_WAIT_TTT;
+		sim_schedule( sim_now() + SIM_MS(concurrent ? cur->ttt * 1000ULL : SDI12_GAP_MS), ev_send_d0, NULL, seq );
+	}
+}
+
+static void ev_timeout(void *ctx, uint32_t arg)
+{
+	(void)ctx;
+	if ( arg != seq )
+		return;
+	if ( phase == PH_RESPONSE && line_len == 0 )  {
+		finish_exchange();				// unanswered
+		end_session();
+	}
+	else if ( phase == PH_RESPONSE )	// response still coming
+		sim_schedule( sim_now() + SIM_MS(SDI12_TIMEOUT_MS), ev_timeout, NULL, seq );
+	else if ( phase == PH_SRQ )  {		// no service request: collect anyway
+		finish_exchange();
+		phase = PH_WAIT_TTT;
+		ev_send_d0( NULL, seq );
+	}
+}
+
+static void tx_byte(void *ctx, uint8_t byte, uint64_t start, uint64_t end)
+{
+	(void)ctx;
+	if ( phase != PH_RESPONSE && phase != PH_SRQ )
+		return;
+	byte &= 0x7F;
+	if ( line_len == 0 )
+		line_first = start;
+	if ( line_len < sizeof(line) )
+		line[line_len++] = (char)byte;
+	if ( byte == '\n' )  {
+		response_line(end);
+		line_len = 0;
+	}
+}
+
+/*
+ * Command queue
+ */
+
+static void next_command(void)
+{
+	char *cmd;
+
+	if ( phase != PH_IDLE || !queue_count )
+		return;
+	cmd = queue[queue_head];
+	queue_head = (queue_head + 1) % SDI12_QUEUE_SIZE;
+	queue_count--;
+	start_exchange(cmd);
+	free(cmd);
+}
+
+static void ev_command(void *ctx, uint32_t arg)
+{
+	(void)arg;
+	if ( queue_count == SDI12_QUEUE_SIZE )  {
+		fprintf(stderr, "sdi12_logger: command queue full, '%s' dropped\n", (char *)ctx);
+		free(ctx);
+		return;
+	}
+	queue[(queue_head + queue_count) % SDI12_QUEUE_SIZE] = ctx;
+	queue_count++;
+	next_command();
+}
+
+/*
+ * Public
+ */
+
+void sdi12_logger_init(double break_ms, double mark_ms)
+{
+	break_cycles = SIM_US( (break_ms > 0 ? break_ms : 12.5) * 1000.0 );
+	mark_cycles = SIM_US( (mark_ms > 0 ? mark_ms : 8.5) * 1000.0 );
+	sim_uart_tx_hook( SIM_UART_SDI12, tx_byte, NULL );
+}
+
+void sdi12_logger_command(uint64_t at, const char *cmd)
+{
+	char *copy = strdup(cmd);
+
+	if ( !copy )
+		abort();
+	sim_schedule( at, ev_command, copy, 0 );
+}
+
+const _sdi12_exchange *sdi12_logger_exchanges(uint16_t *count)
+{
+	*count = exchange_count;
+	return exchanges;
+}
+
+void sdi12_logger_on_exchange(void (*fn)(void *ctx, const _sdi12_exchange *ex), void *ctx)
+{
+	exchange_fn = fn;
+	exchange_ctx = ctx;
+}
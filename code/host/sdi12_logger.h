@@ -0,0 +1,73 @@
+//*****************************************************************************
+//	Header file for simulated SDI-12 data logger - SDI-12 bridge simulator
+//
+//	Drives the bridge's SDI-12 port the way a data logger does: each command
+//	 is preceded by a break (line spacing for at least 12 ms) and a mark of
+//	 at least 8.33 ms, then sent as 1200 baud 7E1 characters. Every bit edge
+//	 is applied to PD0, so the pin change interrupt sees exactly what the
+//	 real line would produce, and each character is handed to USART0 at its
+//	 stop bit. Responses are collected from USART0 and timed against the
+//	 stop bit of the command's last character.
+//
+//	Measurement commands (aM!, aMC!, aC!, aCC!) run as a complete session:
+//	 the atttn response is parsed, the logger waits for the service request
+//	 (M) or for ttt seconds (C), then collects the data with aD0!. A response
+//	 that promises no values ends the session there.
+//*****************************************************************************
+
+#ifndef SDI12_LOGGER_H
+#define SDI12_LOGGER_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#define SDI12_LOGGER_MAX_EXCHANGES	256
+#define SDI12_LOGGER_RESP_MAX		80
+
+#define SDI12_BREAK_MIN_MS			12.0	// logger break
+#define SDI12_MARK_MIN_MS			8.33	// marking after a break
+#define SDI12_RESPONSE_MAX_MS		15.0	// command end to first response bit
+
+typedef struct
+{
+	char		cmd[12];
+	char		resp[SDI12_LOGGER_RESP_MAX];	// without CR LF
+	bool		answered;
+	uint64_t	cmd_end;			// stop bit of the last command character
+	uint64_t	first;				// start bit of the first response character
+	uint64_t	last;				// stop bit of the last response character
+	int16_t		ttt;				// seconds promised by atttn, -1 if none
+	uint64_t	srq;				// service request received, 0 if none
+} _sdi12_exchange;
+
+/*
+ * Description: Attach the logger to the SDI-12 line and USART0.
+ * Input: break and mark durations in ms, 0 for the defaults (12.5, 8.5)
+ * Output: none
+ */
+void sdi12_logger_init(double break_ms, double mark_ms);
+
+/*
+ * Description: Queue a command. It is sent at 'at', or when the exchange in
+ *				progress has finished if that is later. Measurement commands
+ *				are followed by the service request wait and aD0!.
+ * Input: time, command including the address and '!'
+ * Output: none
+ */
+void sdi12_logger_command(uint64_t at, const char *cmd);
+
+/*
+ * Description: Exchanges completed or timed out so far, in order.
+ * Input: pointer receiving the count
+ * Output: array of exchanges
+ */
+const _sdi12_exchange *sdi12_logger_exchanges(uint16_t *count);
+
+/*
+ * Description: Register a callback run after each exchange is recorded.
+ * Input: callback, context
+ * Output: none
+ */
+void sdi12_logger_on_exchange(void (*fn)(void *ctx, const _sdi12_exchange *ex), void *ctx);
+
+#endif
@@ -0,0 +1,898 @@
+//*****************************************************************************
+//	Host simulator module for SDI-12 bridge project
+//
+//	Implements the fake register file behind host/avr/io.h and a virtual-time
+//	 event loop. External stimuli (XBee frames, SDI-12 line levels) are queued
+//	 with sim_schedule(); on-chip peripherals compute their own next event.
+//	 Whenever the firmware gives the simulator control, time is advanced to
+//	 the next event in order, flags are raised and enabled interrupts are
+//	 dispatched with the same priorities as the ATmega644P vector table.
+//*****************************************************************************
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include "sim.h"
+
+#define NEVER				INT64_MAX
+#define SIM_UART_HOOKS		4
+
+/*
+ * Timer model. Counts are kept as "absolute" ticks since 'base' so compare
+ * matches and overflows can be found without stepping the counter.
+ */
+typedef struct
+{
+	uint8_t		bits;				// 8 or 16
+	uint8_t		tccrb, tccra, timsk, ocra, ocrb, tcnt;	// register ids
+	uint32_t	presc;				// 0 = stopped
+	int64_t		base;				// cycle at which the absolute count was zero
+	int64_t		last;				// last absolute count already evaluated
+	uint32_t	frozen;				// TCNT while stopped
+	uint32_t	period;				// counts per wrap
+	uint16_t	top_a, top_b;		// compare values
+	uint8_t		flags;				// TOV/OCFA/OCFB in TIFRn positions
+} _sim_timer;
+
+typedef struct
+{
+	uint8_t			ucsra, ucsrb, ucsrc, ubrr, udr;	// register ids
+	uint8_t			rx_data[2];
+	uint8_t			rx_err[2];
+	uint8_t			rx_count;
+	bool			txc;
+	bool			shifting;
+	int16_t			tx_pending;		// byte waiting in UDR, -1 if empty
+	uint8_t			tx_byte;
+	uint64_t		tx_start, tx_end;
+	sim_uart_tx_fn	hook[SIM_UART_HOOKS];
+	void			*hook_ctx[SIM_UART_HOOKS];
+	uint8_t			hooks;
+} _sim_uart;
+
+typedef struct
+{
+	uint64_t		at;
+	uint64_t		seq;
+	sim_event_fn	fn;
+	void			*ctx;
+	uint32_t		arg;
+} _sim_event;
+
+typedef struct
+{
+	const char		*name;
+	void			(*vect)(void);
+	uint32_t		calls;
+	uint64_t		total, worst;
+} _sim_vector;
+
+// Vectors the firmware may define. Weak, so missing handlers are NULL.
+#define SIM_VECTOR(v)	void v(void) __attribute__((weak));
+SIM_VECTOR(sim_vect_PCINT3)
+SIM_VECTOR(sim_vect_TIMER1_COMPA)
+SIM_VECTOR(sim_vect_TIMER0_COMPA)
+SIM_VECTOR(sim_vect_TIMER0_OVF)
+SIM_VECTOR(sim_vect_USART0_RX)
+SIM_VECTOR(sim_vect_USART0_UDRE)
+SIM_VECTOR(sim_vect_USART0_TX)
+SIM_VECTOR(sim_vect_USART1_RX)
+SIM_VECTOR(sim_vect_USART1_UDRE)
+SIM_VECTOR(sim_vect_USART1_TX)
+SIM_VECTOR(sim_vect_BADISR)
+
+// Priority order of the ATmega644P vector table
+enum
+{
+	V_PCINT3, V_TIMER1_COMPA, V_TIMER0_COMPA, V_TIMER0_OVF,
+	V_USART0_RX, V_USART0_UDRE, V_USART0_TX,
+	V_USART1_RX, V_USART1_UDRE, V_USART1_TX,
+	V_COUNT
+};
+
+static _sim_vector vectors[V_COUNT] =
+{
+	{ "PCINT3_vect",		sim_vect_PCINT3 },
+	{ "TIMER1_COMPA_vect",	sim_vect_TIMER1_COMPA },
+	{ "TIMER0_COMPA_vect",	sim_vect_TIMER0_COMPA },
+	{ "TIMER0_OVF_vect",	sim_vect_TIMER0_OVF },
+	{ "USART0_RX_vect",		sim_vect_USART0_RX },
+	{ "USART0_UDRE_vect",	sim_vect_USART0_UDRE },
+	{ "USART0_TX_vect",		sim_vect_USART0_TX },
+	{ "USART1_RX_vect",		sim_vect_USART1_RX },
+	{ "USART1_UDRE_vect",	sim_vect_USART1_UDRE },
+	{ "USART1_TX_vect",		sim_vect_USART1_TX },
+};
+
+static uint32_t		regs[SIM_NUM_REGS];
+static int16_t		pending_reg = -1;		// register handed out, not yet committed
+static uint32_t		pending_snap;
+
+static uint64_t		now;
+static uint64_t		sleep_cycles;
+static bool			irq_enabled;
+static bool			in_isr;
+static uint8_t		pcifr;
+static uint8_t		pins[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+static _sim_timer	timer0 = { 8,  SIM_TCCR0B, SIM_TCCR0A, SIM_TIMSK0, SIM_OCR0A, SIM_OCR0B, SIM_TCNT0 };
+static _sim_timer	timer1 = { 16, SIM_TCCR1B, SIM_TCCR1A, SIM_TIMSK1, SIM_OCR1A, SIM_OCR1B, SIM_TCNT1 };
+static _sim_uart	uarts[2] =
+{
+	{ SIM_UCSR0A, SIM_UCSR0B, SIM_UCSR0C, SIM_UBRR0, SIM_UDR0, .tx_pending = -1 },
+	{ SIM_UCSR1A, SIM_UCSR1B, SIM_UCSR1C, SIM_UBRR1, SIM_UDR1, .tx_pending = -1 },
+};
+
+static _sim_event	*events;
+static uint32_t		event_count, event_size;
+static uint64_t		event_seq;
+
+#define SIM_MAX_WATCH	8
+static sim_watch_fn	watch_fn[SIM_MAX_WATCH];
+static void			*watch_ctx[SIM_MAX_WATCH];
+static uint8_t		watch_count;
+
+static jmp_buf		run_env;
+static bool			running;
+static uint64_t		deadline;
+
+int firmware_main(void);
+void __real_sdi12_dotask(void);
+
+static void sim_advance(uint64_t cycles);
+
+/*
+ * Event queue (binary heap ordered by time, then by scheduling order)
+ */
+
+static bool event_before(const _sim_event *a, const _sim_event *b)
+{
+	return a->at < b->at || (a->at == b->at && a->seq < b->seq);
+}
+
+void sim_schedule(uint64_t at, sim_event_fn fn, void *ctx, uint32_t arg)
+{
+	uint32_t i;
+	_sim_event ev = { at < now ? now : at, event_seq++, fn, ctx, arg };
+
+	if ( event_count == event_size )  {
+		event_size = event_size ? event_size * 2 : 64;
+		events = realloc(events, event_size * sizeof(*events));
+	}
+	for ( i = event_count++; i > 0 && event_before(&ev, &events[(i - 1) / 2]); i = (i - 1) / 2 )
+		events[i] = events[(i - 1) / 2];
+	events[i] = ev;
+}
+
+static _sim_event event_pop(void)
+{
+	_sim_event top = events[0];
+	_sim_event last = events[--event_count];
+	uint32_t i = 0, c;
+
+	while ( (c = 2 * i + 1) < event_count )  {
+		if ( c + 1 < event_count && event_before(&events[c + 1], &events[c]) )
+			c++;
+		if ( !event_before(&events[c], &last) )
+			break;
+		events[i] = events[c];
+		i = c;
+	}
+	events[i] = last;
+	return top;
+}
+
+/*
+ * Timers
+ */
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int64_t pos_mod(int64_t a, int64_t m)
+{
+	int64_t r = a % m;
+	return r < 0 ? r + m : r;
+}
+
+static uint32_t timer_prescale(uint8_t cs)
+{
+	static const uint32_t div[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };	// 6,7 = external clock
+	return div[cs & 0x07];
+}
+
+static uint32_t timer_count(const _sim_timer *t)
+{
+	if ( !t->presc )
+		return t->frozen;
+	return (uint32_t)pos_mod(floor_div((int64_t)now - t->base, t->presc), t->period);
+}
+
+// Re-read the timer configuration. Call after the current count is final.
+static void timer_configure(_sim_timer *t, uint32_t count)
+{
+	bool ctc;
+
+	t->top_a = t->bits == 8 ? (uint8_t)regs[t->ocra] : (uint16_t)regs[t->ocra];
+	t->top_b = t->bits == 8 ? (uint8_t)regs[t->ocrb] : (uint16_t)regs[t->ocrb];
+	if ( t->bits == 8 )
+		ctc = ( (regs[t->tccra] & 0x03) == 0x02 ) && !( regs[t->tccrb] & (1 << WGM02) );
+	else
+		ctc = ( (regs[t->tccrb] & ((1 << WGM13) | (1 << WGM12))) == (1 << WGM12) );
+	t->period = ctc ? (uint32_t)t->top_a + 1 : (1UL << t->bits);
+	t->presc = timer_prescale(regs[t->tccrb]);
+
+	count %= t->period;
+	if ( t->presc )  {
+		t->base = (int64_t)now - (int64_t)count * t->presc;
+		t->last = count;
+	}
+	else
+		t->frozen = count;
+}
+
+static int64_t timer_next_count(const _sim_timer *t, uint32_t value)
+{
+	int64_t c = t->last + pos_mod((int64_t)value - t->last, t->period);
+	return c == t->last ? c + t->period : c;
+}
+
+// A compare flag is set on the timer clock after the count matches, as
+//  the counter moves on (in CTC mode, as it clears)
+static uint32_t timer_match_count(const _sim_timer *t, uint32_t top)
+{
+	return ( top + 1 ) % t->period;
+}
+
+// Absolute count of the next compare match or overflow after 'last'
+static int64_t timer_next(const _sim_timer *t)
+{
+	int64_t c, best = NEVER;
+
+	if ( !t->presc )
+		return NEVER;
+	if ( t->top_a < t->period )
+		best = timer_next_count(t, timer_match_count(t, t->top_a));
+	if ( t->top_b < t->period && (c = timer_next_count(t, timer_match_count(t, t->top_b))) < best )
+		best = c;
+	if ( t->period == (1UL << t->bits) && (c = timer_next_count(t, 0)) < best )
+		best = c;
+	return best;
+}
+
+static int64_t timer_next_time(const _sim_timer *t)
+{
+	int64_t c = timer_next(t);
+	return c == NEVER ? NEVER : t->base + c * (int64_t)t->presc;
+}
+
+static void timer_fire(_sim_timer *t)
+{
+	int64_t c = timer_next(t);
+	int64_t v = pos_mod(c, t->period);
+
+	if ( t->top_a < t->period && v == timer_match_count(t, t->top_a) )
+		t->flags |= (1 << OCF1A);
+	if ( t->top_b < t->period && v == timer_match_count(t, t->top_b) )
+		t->flags |= (1 << OCF1B);
+	if ( v == 0 && t->period == (1UL << t->bits) )
+		t->flags |= (1 << TOV1);
+	t->last = c;
+}
+
+/*
+ * USARTs
+ */
+
+uint64_t sim_uart_frame_cycles(uint8_t n)
+{
+	const _sim_uart *u = &uarts[n];
+	uint8_t ucsra = regs[u->ucsra], ucsrb = regs[u->ucsrb], ucsrc = regs[u->ucsrc];
+	uint32_t bit = ( (ucsra & (1 << U2X0)) ? 8 : 16 ) * ( (uint32_t)(regs[u->ubrr] & 0x0FFF) + 1 );
+	uint8_t data = 5 + ( (ucsrc >> UCSZ00) & 0x03 ) + ( (ucsrb & (1 << UCSZ02)) ? 4 : 0 );
+	uint8_t bits = 1 + data + ( (ucsrc & (1 << UPM01)) ? 1 : 0 ) + ( (ucsrc & (1 << USBS0)) ? 2 : 1 );
+
+	return (uint64_t)bit * bits;
+}
+
+static void uart_write(uint8_t n, uint8_t byte)
+{
+	_sim_uart *u = &uarts[n];
+
+	if ( !(regs[u->ucsrb] & (1 << TXEN0)) )
+		return;
+	if ( !u->shifting )  {
+		u->shifting = true;
+		u->tx_byte = byte;
+		u->tx_start = now;
+		u->tx_end = now + sim_uart_frame_cycles(n);
+		u->txc = false;
+	}
+	else
+		u->tx_pending = byte;		// overwrites a byte that is already waiting
+}
+
+static void uart_tx_done(uint8_t n)
+{
+	_sim_uart *u = &uarts[n];
+	uint8_t i;
+
+	for ( i = 0; i < u->hooks; i++ )
+		u->hook[i](u->hook_ctx[i], u->tx_byte, u->tx_start, u->tx_end);
+	if ( u->tx_pending >= 0 )  {
+		u->tx_byte = (uint8_t)u->tx_pending;
+		u->tx_pending = -1;
+		u->tx_start = u->tx_end;
+		u->tx_end += sim_uart_frame_cycles(n);
+	}
+	else  {
+		u->shifting = false;
+		u->txc = true;
+	}
+}
+
+void sim_uart_rx(uint8_t n, uint8_t byte, uint8_t errors)
+{
+	_sim_uart *u = &uarts[n];
+
+	if ( !(regs[u->ucsrb] & (1 << RXEN0)) )
+		return;
+	if ( u->rx_count < 2 )  {
+		u->rx_data[u->rx_count] = byte;
+		u->rx_err[u->rx_count] = errors;
+		u->rx_count++;
+	}
+	else
+		u->rx_err[1] |= SIM_RX_DOR;
+}
+
+static void uart_rx_event(void *ctx, uint32_t arg)
+{
+	sim_uart_rx((uint8_t)(uintptr_t)ctx, (uint8_t)arg, (uint8_t)(arg >> 8));
+}
+
+uint64_t sim_uart_rx_burst(uint8_t n, uint64_t start, const uint8_t *data, uint16_t len)
+{
+	uint64_t frame = sim_uart_frame_cycles(n);
+	uint16_t i;
+
+	for ( i = 0; i < len; i++ )
+		sim_schedule(start + (i + 1) * frame, uart_rx_event, (void *)(uintptr_t)n, data[i]);
+	return start + len * frame;
+}
+
+void sim_uart_tx_hook(uint8_t n, sim_uart_tx_fn fn, void *ctx)
+{
+	_sim_uart *u = &uarts[n];
+
+	if ( u->hooks < SIM_UART_HOOKS )  {
+		u->hook[u->hooks] = fn;
+		u->hook_ctx[u->hooks] = ctx;
+		u->hooks++;
+	}
+}
+
+static uint8_t uart_status(const _sim_uart *u)
+{
+	uint8_t a = regs[u->ucsra] & ((1 << U2X0) | (1 << MPCM0));
+
+	if ( u->rx_count )
+		a |= (1 << RXC0) | (u->rx_err[0] & (SIM_RX_FE | SIM_RX_DOR | SIM_RX_UPE));
+	if ( u->txc )
+		a |= (1 << TXC0);
+	if ( u->tx_pending < 0 )
+		a |= (1 << UDRE0);
+	return a;
+}
+
+static void uart_pop(_sim_uart *u)
+{
+	if ( !u->rx_count )
+		return;
+	u->rx_data[0] = u->rx_data[1];
+	u->rx_err[0] = u->rx_err[1];
+	u->rx_count--;
+}
+
+/*
+ * Pins
+ */
+
+void sim_pin_set(uint8_t port, uint8_t pin, bool level)
+{
+	static const uint8_t pcmsk[4] = { SIM_PCMSK0, SIM_PCMSK1, SIM_PCMSK2, SIM_PCMSK3 };
+	uint8_t old = pins[port];
+
+	if ( level )
+		pins[port] |= (1 << pin);
+	else
+		pins[port] &= ~(1 << pin);
+	if ( old != pins[port] && (regs[pcmsk[port]] & (1 << pin)) )
+		pcifr |= (1 << port);
+}
+
+/*
+ * Register file
+ */
+
+static _sim_uart *uart_of(uint8_t reg)
+{
+	if ( reg >= SIM_UCSR1A )
+		return &uarts[1];
+	return &uarts[0];
+}
+
+static void reg_written(uint8_t reg, uint32_t val)
+{
+	switch ( reg )  {
+		// restoring a saved SREG: handlers do not nest, so only outside one
+		case SIM_SREG:
+			if ( !in_isr )
+				irq_enabled = (val & 0x80) != 0;
+		break;
+
+		case SIM_UDR0:
+		case SIM_UDR1:
+			uart_write( reg == SIM_UDR1, (uint8_t)val );
+		break;
+
+		case SIM_UCSR0A:
+		case SIM_UCSR1A:
+			if ( val & (1 << TXC0) )
+				uart_of(reg)->txc = false;
+		break;
+
+		case SIM_UCSR0B:
+		case SIM_UCSR1B:
+			if ( !(val & (1 << RXEN0)) )
+				uart_of(reg)->rx_count = 0;
+		break;
+
+		case SIM_PCIFR:
+			pcifr &= ~val;
+		break;
+
+		case SIM_TIFR0:
+			timer0.flags &= ~val;
+		break;
+
+		case SIM_TIFR1:
+			timer1.flags &= ~val;
+		break;
+
+		case SIM_TCNT0:
+			timer_configure( &timer0, (uint8_t)val );
+		break;
+
+		case SIM_TCNT1:
+			timer_configure( &timer1, (uint16_t)val );
+		break;
+
+		// the timer structs still hold the old configuration, so the
+		//  count is taken before the new register values are applied
+		case SIM_TCCR0A:
+		case SIM_TCCR0B:
+		case SIM_OCR0A:
+		case SIM_OCR0B:
+			timer_configure( &timer0, timer_count(&timer0) );
+		break;
+
+		case SIM_TCCR1A:
+		case SIM_TCCR1B:
+		case SIM_OCR1A:
+		case SIM_OCR1B:
+			timer_configure( &timer1, timer_count(&timer1) );
+		break;
+	}
+}
+
+// Called before the simulator does anything else: the firmware has finished
+//  with the register it was handed, so find out whether it wrote to it.
+static void sim_commit(void)
+{
+	int16_t reg = pending_reg;
+
+	if ( reg < 0 )
+		return;
+	pending_reg = -1;
+	if ( regs[reg] != pending_snap )
+		reg_written( (uint8_t)reg, regs[reg] );
+	else if ( reg == SIM_UDR0 || reg == SIM_UDR1 )
+		uart_pop( uart_of((uint8_t)reg) );
+}
+
+// Load the live value of a register into its cell before the firmware reads it
+static void reg_prepare(uint8_t reg)
+{
+	switch ( reg )  {
+		case SIM_SREG:
+			regs[reg] = irq_enabled ? 0x80 : 0;
+		break;
+
+		case SIM_PINA: regs[reg] = pins[0]; break;
+		case SIM_PINB: regs[reg] = pins[1]; break;
+		case SIM_PINC: regs[reg] = pins[2]; break;
+		case SIM_PIND: regs[reg] = pins[3]; break;
+
+		case SIM_UCSR0A:
+		case SIM_UCSR1A:
+			regs[reg] = uart_status( uart_of(reg) );
+		break;
+
+		case SIM_UDR0:
+		case SIM_UDR1:
+			regs[reg] = 0x100 | uart_of(reg)->rx_data[0];
+		break;
+
+		case SIM_TCNT0:
+			regs[reg] = timer_count(&timer0);
+		break;
+
+		case SIM_TCNT1:
+			regs[reg] = 0x10000 | timer_count(&timer1);
+		break;
+
+		// write-one-to-clear flag registers read back as zero
+		case SIM_PCIFR:
+		case SIM_TIFR0:
+		case SIM_TIFR1:
+			regs[reg] = 0;
+		break;
+	}
+}
+
+volatile void *sim_io(uint8_t reg)
+{
+	sim_commit();
+	sim_advance(SIM_COST_IO);
+	reg_prepare(reg);
+	pending_reg = reg;
+	pending_snap = regs[reg];
+	return &regs[reg];
+}
+
+/*
+ * Interrupts
+ */
+
+static bool vector_pending(uint8_t v, bool take)
+{
+	_sim_uart *u;
+	bool hit = false;
+
+	switch ( v )  {
+		case V_PCINT3:
+			hit = (pcifr & (1 << PCIF3)) && (regs[SIM_PCICR] & (1 << PCIE3));
+			if ( hit && take )
+				pcifr &= ~(1 << PCIF3);
+		break;
+
+		case V_TIMER1_COMPA:
+			hit = (timer1.flags & (1 << OCF1A)) && (regs[SIM_TIMSK1] & (1 << OCIE1A));
+			if ( hit && take )
+				timer1.flags &= ~(1 << OCF1A);
+		break;
+
+		case V_TIMER0_COMPA:
+			hit = (timer0.flags & (1 << OCF0A)) && (regs[SIM_TIMSK0] & (1 << OCIE0A));
+			if ( hit && take )
+				timer0.flags &= ~(1 << OCF0A);
+		break;
+
+		case V_TIMER0_OVF:
+			hit = (timer0.flags & (1 << TOV0)) && (regs[SIM_TIMSK0] & (1 << TOIE0));
+			if ( hit && take )
+				timer0.flags &= ~(1 << TOV0);
+		break;
+
+		case V_USART0_RX:
+		case V_USART1_RX:
+			u = &uarts[v == V_USART1_RX];
+			hit = u->rx_count && (regs[u->ucsrb] & (1 << RXCIE0));
+		break;
+
+		case V_USART0_UDRE:
+		case V_USART1_UDRE:
+			u = &uarts[v == V_USART1_UDRE];
+			hit = (u->tx_pending < 0) && (regs[u->ucsrb] & (1 << UDRIE0));
+		break;
+
+		case V_USART0_TX:
+		case V_USART1_TX:
+			u = &uarts[v == V_USART1_TX];
+			hit = u->txc && (regs[u->ucsrb] & (1 << TXCIE0));
+			if ( hit && take )
+				u->txc = false;
+		break;
+	}
+	return hit;
+}
+
+static void sim_dispatch(void)
+{
+	uint8_t v;
+	uint64_t start;
+	_sim_vector *vec;
+
+	while ( irq_enabled && !in_isr )  {
+		for ( v = 0; v < V_COUNT && !vector_pending(v, false); v++ )
+			;
+		if ( v == V_COUNT )
+			break;
+		vector_pending(v, true);
+		vec = &vectors[v];
+		if ( !vec->vect )  {
+			if ( !sim_vect_BADISR )  {
+				fprintf(stderr, "sim: %s enabled without a handler\n", vec->name);
+				abort();
+			}
+			vec->vect = sim_vect_BADISR;
+		}
+
+		start = now;
+		in_isr = true;
+		irq_enabled = false;
+		now += SIM_COST_ISR / 2;
+		vec->vect();
+		sim_commit();
+		now += SIM_COST_ISR - SIM_COST_ISR / 2;
+		in_isr = false;
+		irq_enabled = true;
+
+		vec->calls++;
+		vec->total += now - start;
+		if ( now - start > vec->worst )
+			vec->worst = now - start;
+	}
+}
+
+void sim_sei(void)
+{
+	sim_commit();
+	irq_enabled = true;
+	sim_dispatch();
+}
+
+void sim_cli(void)
+{
+	sim_commit();
+	irq_enabled = false;
+}
+
+/*
+ * Time
+ */
+
+static int64_t next_event_time(void)
+{
+	int64_t t = event_count ? (int64_t)events[0].at : NEVER, c;
+	uint8_t n;
+
+	if ( (c = timer_next_time(&timer0)) < t )
+		t = c;
+	if ( (c = timer_next_time(&timer1)) < t )
+		t = c;
+	for ( n = 0; n < 2; n++ )
+		if ( uarts[n].shifting && (int64_t)uarts[n].tx_end < t )
+			t = uarts[n].tx_end;
+	return t;
+}
+
+static void process_events(void)
+{
+	uint8_t n;
+	_sim_event ev;
+
+	while ( timer_next_time(&timer0) <= (int64_t)now )
+		timer_fire(&timer0);
+	while ( timer_next_time(&timer1) <= (int64_t)now )
+		timer_fire(&timer1);
+	for ( n = 0; n < 2; n++ )
+		while ( uarts[n].shifting && uarts[n].tx_end <= now )
+			uart_tx_done(n);
+	while ( event_count && events[0].at <= now )  {
+		ev = event_pop();
+		ev.fn(ev.ctx, ev.arg);
+	}
+}
+
+static void sim_advance(uint64_t cycles)
+{
+	uint64_t target = now + cycles;
+	int64_t t;
+
+	while ( (t = next_event_time()) <= (int64_t)target )  {
+		if ( t > (int64_t)now )
+			now = (uint64_t)t;
+		process_events();
+		sim_dispatch();
+		if ( now > target )
+			target = now;
+	}
+	now = target;
+	sim_dispatch();
+
+	if ( running && !in_isr && now >= deadline )  {
+		running = false;
+		longjmp(run_env, 1);
+	}
+}
+
+void sim_delay_us(double us)
+{
+	sim_commit();
+	sim_advance( (uint64_t)(us * SIM_CYCLES_PER_US) );
+}
+
+// Idle mode: time runs on to the first event that raises an enabled
+//  interrupt, which is taken before returning
+void sim_sleep(void)
+{
+	uint64_t start;
+	int64_t t;
+	uint8_t v;
+
+	sim_commit();
+	start = now;
+	while ( irq_enabled )  {
+		for ( v = 0; v < V_COUNT && !vector_pending(v, false); v++ )
+			;
+		if ( v < V_COUNT )
+			break;
+		t = next_event_time();
+		if ( t >= (int64_t)deadline )  {
+			if ( now < deadline )
+				now = deadline;
+			break;
+		}
+		if ( t > (int64_t)now )
+			now = (uint64_t)t;
+		process_events();
+	}
+	sleep_cycles += now - start;
+	sim_advance(0);
+}
+
+uint64_t sim_sleep_cycles(void)
+{
+	return sleep_cycles;
+}
+
+uint64_t sim_now(void)
+{
+	return now;
+}
+
+/*
+ * EEPROM
+ */
+
+#define SIM_EEPROM_WRITE_US		3400.0
+
+extern uint8_t __start_sim_eeprom[] __attribute__((weak));
+extern uint8_t __stop_sim_eeprom[] __attribute__((weak));
+
+static uint32_t eeprom_writes;
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	memcpy(dst, src, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+
+	for ( ; n; n--, s++, d++ )  {
+		if ( *d == *s )
+			continue;
+		*d = *s;
+		eeprom_writes++;
+		sim_delay_us(SIM_EEPROM_WRITE_US);
+	}
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	return *p;
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+	eeprom_update_block(&value, p, 1);
+}
+
+// The file holds the EEMEM section as saved by sim_eeprom_save() from the
+//  same build; anything else is ignored and EEPROM stays erased (0xFF).
+bool sim_eeprom_load(const char *path)
+{
+	size_t size = (size_t)(__stop_sim_eeprom - __start_sim_eeprom);
+	FILE *fp;
+	bool ok = false;
+
+	if ( size )
+		memset(__start_sim_eeprom, 0xFF, size);
+	fp = fopen(path, "rb");
+	if ( !fp )
+		return false;
+	if ( size && fread(__start_sim_eeprom, 1, size, fp) == size && fgetc(fp) == EOF )
+		ok = true;
+	else if ( size )
+		memset(__start_sim_eeprom, 0xFF, size);
+	fclose(fp);
+	return ok;
+}
+
+bool sim_eeprom_save(const char *path)
+{
+	size_t size = (size_t)(__stop_sim_eeprom - __start_sim_eeprom);
+	FILE *fp = fopen(path, "wb");
+	bool ok;
+
+	if ( !fp )
+		return false;
+	ok = fwrite(__start_sim_eeprom, 1, size, fp) == size;
+	return fclose(fp) == 0 && ok;
+}
+
+uint32_t sim_eeprom_writes(void)
+{
+	return eeprom_writes;
+}
+
+/*
+ * Running the firmware
+ */
+
+void sim_watch(sim_watch_fn fn, void *ctx)
+{
+	if ( watch_count < SIM_MAX_WATCH )  {
+		watch_fn[watch_count] = fn;
+		watch_ctx[watch_count] = ctx;
+		watch_count++;
+	}
+}
+
+// The firmware's main loop calls sdi12_dotask() once per pass. The link step
+//  wraps it (-Wl,--wrap=sdi12_dotask) so each pass costs time and lets the
+//  observers look at the state machine.
+void __wrap_sdi12_dotask(void)
+{
+	uint8_t i;
+
+	sim_commit();
+	sim_advance(SIM_COST_LOOP);
+	for ( i = 0; i < watch_count; i++ )
+		watch_fn[i](watch_ctx[i]);
+	__real_sdi12_dotask();
+}
+
+uint64_t sim_run(uint64_t until)
+{
+	deadline = until;
+	running = true;
+	if ( setjmp(run_env) == 0 )  {
+		firmware_main();
+		running = false;
+	}
+	return now;
+}
+
+void sim_stop(void)
+{
+	deadline = now;
+}
+
+void sim_isr_stats(void (*fn)(const char *name, uint32_t calls, uint64_t total, uint64_t worst))
+{
+	uint8_t v;
+
+	for ( v = 0; v < V_COUNT; v++ )
+		if ( vectors[v].calls )
+			fn(vectors[v].name, vectors[v].calls, vectors[v].total, vectors[v].worst);
+}
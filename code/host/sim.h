@@ -0,0 +1,163 @@
+//*****************************************************************************
+//	Header file for host simulator of SDI-12 bridge project
+//
+//	Discrete-event model of the ATmega644P peripherals the bridge firmware
+//	 uses: Timer0, Timer1, USART0 (SDI-12), USART1 (XBee) and the port D pin
+//	 change interrupt. Time is counted in CPU cycles at F_CPU and only moves
+//	 when the firmware touches a register, passes through its main loop, or
+//	 busy-waits in _delay_ms(), so every run is exactly repeatable.
+//
+//	The firmware's main() is built as firmware_main() and is entered once per
+//	 process by sim_run(). Global state is not reset between runs; drivers
+//	 that need several runs fork() a child for each.
+//*****************************************************************************
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#define SIM_F_CPU				16000000UL
+#define SIM_CYCLES_PER_US		(SIM_F_CPU / 1000000UL)
+
+#define SIM_US(us)				((uint64_t)(us) * SIM_CYCLES_PER_US)
+#define SIM_MS(ms)				(SIM_US(ms) * 1000ULL)
+#define SIM_TO_US(cycles)		((double)(cycles) / SIM_CYCLES_PER_US)
+
+// Cost model. Only register accesses, main loop passes and interrupt entry
+//  and exit consume time; plain C between them is free. Cycle-accurate
+//  figures come from the simavr benchmarks, not from here.
+#define SIM_COST_IO				2			// cycles per I/O register access
+#define SIM_COST_LOOP			40			// cycles per pass of the main loop
+#define SIM_COST_ISR			20			// cycles for vector, prologue and reti
+
+#define SIM_UART_SDI12			0
+#define SIM_UART_XBEE			1
+
+// UART receive error flags for sim_uart_rx(), same positions as UCSRnA
+#define SIM_RX_FE				(1 << 4)
+#define SIM_RX_DOR				(1 << 3)
+#define SIM_RX_UPE				(1 << 2)
+
+#define SIM_PORT_D				3
+#define SIM_SDI12_RX_PIN		0			// PD0 = RXD0, also PCINT24
+
+typedef void (*sim_event_fn)(void *ctx, uint32_t arg);
+typedef void (*sim_uart_tx_fn)(void *ctx, uint8_t byte, uint64_t start, uint64_t end);
+typedef void (*sim_watch_fn)(void *ctx);
+
+/*
+ * Description: Current virtual time.
+ * Input: none
+ * Output: cycles since reset
+ */
+uint64_t sim_now(void);
+
+/*
+ * Description: Run fn(ctx, arg) when virtual time reaches 'at'. Events with
+ *				equal times run in the order they were scheduled.
+ * Input: absolute time in cycles, callback, callback arguments
+ * Output: none
+ */
+void sim_schedule(uint64_t at, sim_event_fn fn, void *ctx, uint32_t arg);
+
+/*
+ * Description: Hand a received character to a USART, as if its stop bit had
+ *				just been sampled. Dropped if the receiver is disabled.
+ * Input: USART number, character, SIM_RX_* error flags
+ * Output: none
+ */
+void sim_uart_rx(uint8_t uart, uint8_t byte, uint8_t errors);
+
+/*
+ * Description: Schedule a burst of back-to-back characters into a USART,
+ *				spaced at the frame time currently programmed for it.
+ * Input: USART number, time of the first start bit, data, length
+ * Output: time the last stop bit ends
+ */
+uint64_t sim_uart_rx_burst(uint8_t uart, uint64_t start, const uint8_t *data, uint16_t len);
+
+/*
+ * Description: Duration of one character frame with the current UBRR/UCSRnC.
+ * Input: USART number
+ * Output: cycles per frame
+ */
+uint64_t sim_uart_frame_cycles(uint8_t uart);
+
+/*
+ * Description: Observe every character the firmware transmits on a USART.
+ *				Up to four observers per USART, called in the order added.
+ * Input: USART number, callback (called when the stop bit ends), context
+ * Output: none
+ */
+void sim_uart_tx_hook(uint8_t uart, sim_uart_tx_fn fn, void *ctx);
+
+/*
+ * Description: Drive an input pin. Raises a pin change interrupt when the pin
+ *				is enabled in the matching PCMSK register.
+ * Input: port (0 = A ... 3 = D), pin, level
+ * Output: none
+ */
+void sim_pin_set(uint8_t port, uint8_t pin, bool level);
+
+/*
+ * Description: Register a callback run on every pass of the firmware main
+ *				loop, before sdi12_dotask().
+ * Input: callback, context
+ * Output: none
+ */
+void sim_watch(sim_watch_fn fn, void *ctx);
+
+/*
+ * Description: Start the firmware from reset and run it until virtual time
+ *				reaches 'until' or sim_stop() is called. Once per process.
+ * Input: absolute end time in cycles
+ * Output: virtual time at which the run stopped
+ */
+uint64_t sim_run(uint64_t until);
+
+/*
+ * Description: Set EEPROM (the firmware's EEMEM variables) from a file
+ *				written by sim_eeprom_save(). Call before sim_run().
+ * Input: path
+ * Output: true if loaded; otherwise EEPROM is left erased
+ */
+bool sim_eeprom_load(const char *path);
+
+/*
+ * Description: Write EEPROM to a file.
+ * Input: path
+ * Output: true if written
+ */
+bool sim_eeprom_save(const char *path);
+
+/*
+ * Description: EEPROM bytes programmed so far (unchanged bytes are skipped).
+ * Input: none
+ * Output: count
+ */
+uint32_t sim_eeprom_writes(void);
+
+/*
+ * Description: End the current run at the next point outside an interrupt.
+ * Input: none
+ * Output: none
+ */
+void sim_stop(void);
+
+/*
+ * Description: Time the firmware has spent asleep in sleep_cpu().
+ * Input: none
+ * Output: cycles
+ */
+uint64_t sim_sleep_cycles(void);
+
+/*
+ * Description: Cycles spent inside interrupt handlers, per vector name.
+ * Input: callback receiving name, calls, total and worst-case cycles
+ * Output: none
+ */
+void sim_isr_stats(void (*fn)(const char *name, uint32_t calls, uint64_t total, uint64_t worst));
+
+#endif
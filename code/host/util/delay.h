@@ -0,0 +1,16 @@
+//*****************************************************************************
+//	Host replacement for <util/delay.h> - SDI-12 bridge simulator
+//
+//	Busy-wait delays advance virtual time. Interrupts keep firing during the
+//	 delay, as they do on the target.
+//*****************************************************************************
+
+#ifndef SIM_UTIL_DELAY_H
+#define SIM_UTIL_DELAY_H
+
+void sim_delay_us(double us);
+
+#define _delay_us(us)		sim_delay_us(us)
+#define _delay_ms(ms)		sim_delay_us((ms) * 1000.0)
+
+#endif
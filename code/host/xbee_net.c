@@ -0,0 +1,496 @@
+//*****************************************************************************
+//	Simulated DigiMesh network - SDI-12 bridge simulator
+//
+//	Delivery model: each remote AT command travels 'hops' hops of 'hop_ms'
+//	 each way. Every transmission attempt is lost with probability 'loss' and
+//	 retried after 'retry_ms', up to 'attempts' times per direction. If the
+//	 command never arrives the coordinator reports a TX failure (status 0x04);
+//	 if the response never arrives nothing is sent and the firmware times out.
+//	 Nodes that were told to sleep with the network (remote SM) can only be
+//	 reached while it is awake; commands for them wait for the next wake.
+//	 Parameters sent with the queue option (no 0x02 bit) take effect at AC.
+//	 A node with IR set and DH/DL pointing at the coordinator pushes an IO
+//	 sample (0x92) every IR ms while it is awake, delivered like a response.
+//*****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "xbee_net.h"
+
+#define XBEE_FRAME_MAX			100
+#define XBEE_NODE_PROCESS_MS	2			// remote AT turnaround in the node
+
+#define API_LOCAL_AT			0x08
+#define API_REMOTE_AT			0x17
+#define API_LOCAL_RESPONSE		0x88
+#define API_MODEM_STATUS		0x8A
+#define API_REMOTE_RESPONSE		0x97
+#define API_IO_SAMPLE			0x92
+
+#define COORD_SH				0x0013A200UL		// the coordinator's own serial number
+#define COORD_SL				0x40B00000UL
+
+#define MODEM_WOKE_UP			0x0B
+#define MODEM_ASLEEP			0x0C
+
+#define AT(a, b)				(((uint16_t)(a) << 8) | (b))
+
+typedef struct
+{
+	_xbee_node_cfg	cfg;
+	bool			sleeps;					// remote SM received
+	uint8_t			dio_out;				// D8 (bit 0) and D9 (bit 1) driven high
+	uint8_t			dio_set;				// as written, applied to dio_out by options 0x02 or AC
+	uint32_t		dh, dl, dh_set, dl_set;	// sample destination, active and as written
+	uint16_t		ir, ir_set;				// sample rate in ms, active and as written
+	uint32_t		push_gen;				// invalidates pending push events
+} _xbee_node;
+
+typedef struct
+{
+	uint16_t		len;
+	uint8_t			data[XBEE_FRAME_MAX + 4];
+} _xbee_frame;
+
+static _xbee_net_cfg	net = { 1, 13000, 3, 3, 40, false };
+static _xbee_net_stats	stats;
+static _xbee_node		nodes_sim[XBEE_NET_MAX_NODES];
+static uint8_t			node_count;
+static uint32_t			rng;
+
+static uint8_t			rx[XBEE_FRAME_MAX + 4];		// frame coming from the firmware
+static uint16_t			rx_len;
+static uint64_t			line_free;					// USART1 RX line busy until
+
+// Coordinator sleep settings, as written by local AT commands
+static uint16_t			sp = 0x20, st = 2000;		// SP in 10 ms units, ST in ms
+static uint8_t			so, sm;
+static bool				cycling, awake = true;
+static uint64_t			next_wake;
+
+static double random_unit(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return (double)rng / 4294967296.0;
+}
+
+static _xbee_node *find_node(uint32_t SH, uint32_t SL)
+{
+	uint8_t i;
+
+	for ( i = 0; i < node_count; i++ )
+		if ( nodes_sim[i].cfg.SH == SH && nodes_sim[i].cfg.SL == SL )
+			return &nodes_sim[i];
+	return NULL;
+}
+
+// DIO byte with the DIP switch inputs as wired on the node board: a closed
+//  switch pulls its input low. Inverse of DIP_to_ID() in wireless_xbee.c.
+static uint8_t dip_to_dio(uint8_t dip)
+{
+	uint8_t dio = 0xD2;
+
+	if ( dip & 0x01 ) dio &= ~0x02;
+	if ( dip & 0x02 ) dio &= ~0x10;
+	if ( dip & 0x04 ) dio &= ~0x80;
+	if ( dip & 0x08 ) dio &= ~0x40;
+	return dio;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+	*p++ = (uint8_t)(v >> 24);
+	*p++ = (uint8_t)(v >> 16);
+	*p++ = (uint8_t)(v >> 8);
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+/*
+ * Output to the firmware
+ */
+
+static void ev_frame_ready(void *ctx, uint32_t arg)
+{
+	_xbee_frame *f = ctx;
+	uint64_t start = line_free > sim_now() ? line_free : sim_now();
+
+	(void)arg;
+	line_free = sim_uart_rx_burst( SIM_UART_XBEE, start, f->data, f->len );
+	stats.frames_out++;
+	free(f);
+}
+
+// Queue an API frame; it goes onto the line at 'at' or when the line is free
+static void send_frame(uint64_t at, const uint8_t *data, uint16_t len)
+{
+	_xbee_frame *f = malloc(sizeof(*f));
+	uint8_t sum = 0;
+	uint16_t i;
+
+	if ( !f )
+		abort();
+	f->data[0] = 0x7E;
+	f->data[1] = (uint8_t)(len >> 8);
+	f->data[2] = (uint8_t)len;
+	for ( i = 0; i < len; i++ )  {
+		f->data[3 + i] = data[i];
+		sum += data[i];
+	}
+	f->data[3 + len] = 0xFF - sum;
+	f->len = len + 4;
+	sim_schedule( at, ev_frame_ready, f, 0 );
+}
+
+static void send_modem_status(uint64_t at, uint8_t status)
+{
+	uint8_t d[2] = { API_MODEM_STATUS, status };
+	send_frame( at, d, sizeof(d) );
+}
+
+/*
+ * Coordinator sleep cycle
+ */
+
+static void ev_sleep_cycle(void *ctx, uint32_t wake)
+{
+	(void)ctx;
+	awake = wake;
+	if ( so & 0x04 )
+		send_modem_status( sim_now(), wake ? MODEM_WOKE_UP : MODEM_ASLEEP );
+	if ( wake && net.stay_awake )
+		return;
+	if ( wake )
+		sim_schedule( sim_now() + SIM_MS(st), ev_sleep_cycle, NULL, 0 );
+	else  {
+		next_wake = sim_now() + SIM_MS(sp * 10ULL);
+		sim_schedule( next_wake, ev_sleep_cycle, NULL, 1 );
+	}
+}
+
+// A sleep coordinator starts its cycle asleep, waking one SP later
+static void start_sleep_cycle(void)
+{
+	cycling = true;
+	awake = false;
+	next_wake = sim_now() + SIM_MS(sp * 10ULL);
+	sim_schedule( next_wake, ev_sleep_cycle, NULL, 1 );
+}
+
+/*
+ * Input from the firmware
+ */
+
+static void local_at(const uint8_t *f, uint16_t len)
+{
+	uint8_t frame_id = f[1];
+	uint16_t cmd = AT(f[2], f[3]);
+	const uint8_t *param = f + 4;
+	uint16_t plen = len - 4;
+	uint8_t resp[40], *p;
+	uint64_t t = sim_now() + SIM_MS(net.local_ms);
+	uint8_t i;
+
+	switch ( cmd )  {
+		case AT('N','D'):
+			// One response per node inside the NT window. The end-of-discovery
+			//  frame is not sent; the firmware times node discovery itself.
+			for ( i = 0; i < node_count; i++ )  {
+				_xbee_node *n = &nodes_sim[i];
+				p = resp;
+				*p++ = API_LOCAL_RESPONSE;
+				*p++ = frame_id;
+				*p++ = 'N';
+				*p++ = 'D';
+				*p++ = XBEE_STATUS_OK;
+				*p++ = 0xFF;						// MY
+				*p++ = 0xFE;
+				p = put32(p, n->cfg.SH);
+				p = put32(p, n->cfg.SL);
+				*p++ = ' ';							// NI
+				*p++ = 0;
+				*p++ = 0xFF;						// parent
+				*p++ = 0xFE;
+				*p++ = 0x01;						// device type: router
+				*p++ = 0x00;						// status
+				*p++ = 0xC1;						// profile
+				*p++ = 0x05;
+				*p++ = 0x10;						// manufacturer
+				*p++ = 0x1E;
+				send_frame( t + SIM_MS(2ULL * n->cfg.hops * n->cfg.hop_ms)
+					+ (uint64_t)(random_unit() * SIM_MS(net.nt_ms)), resp, (uint16_t)(p - resp) );
+			}
+			return;
+
+		case AT('S','P'):
+			if ( plen >= 2 )
+				sp = (uint16_t)((param[0] << 8) | param[1]);
+		break;
+
+		case AT('S','T'):
+			if ( plen >= 2 )
+				st = (uint16_t)((param[0] << 8) | param[1]);
+		break;
+
+		case AT('S','O'):
+			if ( plen >= 1 )
+				so = param[plen - 1];
+		break;
+
+		case AT('S','M'):
+			if ( plen >= 1 )
+				sm = param[plen - 1];
+			if ( sm == 7 && !cycling )
+				start_sleep_cycle();
+		break;
+	}
+
+	if ( frame_id )  {
+		resp[0] = API_LOCAL_RESPONSE;
+		resp[1] = frame_id;
+		resp[2] = f[2];
+		resp[3] = f[3];
+		resp[4] = XBEE_STATUS_OK;
+		p = resp + 5;
+		if ( cmd == AT('S','H') && !plen )
+			p = put32(p, COORD_SH);
+		else if ( cmd == AT('S','L') && !plen )
+			p = put32(p, COORD_SL);
+		send_frame( t, resp, (uint16_t)(p - resp) );
+	}
+}
+
+// Time taken to get one transmission across, or 0 if every attempt was lost
+static uint64_t deliver(const _xbee_node *n)
+{
+	uint64_t t = 0;
+	uint8_t a;
+
+	for ( a = 0; a < net.attempts; a++ )  {
+		if ( a )
+			t += SIM_MS(net.retry_ms);
+		t += SIM_MS((uint64_t)n->cfg.hops * n->cfg.hop_ms);
+		if ( random_unit() >= n->cfg.loss )
+			return t;
+		stats.lost++;
+	}
+	return 0;
+}
+
+static void ev_push(void *ctx, uint32_t gen)
+{
+	_xbee_node *n = ctx;
+	uint8_t d[22], *p = d;
+	uint64_t out;
+
+	if ( gen != n->push_gen || !n->ir )
+		return;
+	sim_schedule( sim_now() + SIM_MS(n->ir), ev_push, n, gen );
+	if ( (n->sleeps && cycling && !awake) || n->dh != COORD_SH || n->dl != COORD_SL )
+		return;
+	out = deliver(n);
+	if ( !out )
+		return;
+
+	*p++ = API_IO_SAMPLE;
+	p = put32(p, n->cfg.SH);
+	p = put32(p, n->cfg.SL);
+	*p++ = 0xFF;
+	*p++ = 0xFE;
+	*p++ = 0x01;								// receive options: acknowledged
+	*p++ = 0x01;								// one sample set, as in IS
+	*p++ = 0x00;
+	*p++ = 0xD2;
+	*p++ = 0x0C;
+	*p++ = 0x00;
+	*p++ = dip_to_dio(n->cfg.dip);
+	*p++ = (uint8_t)(n->cfg.adc[0] >> 8);
+	*p++ = (uint8_t)n->cfg.adc[0];
+	*p++ = (uint8_t)(n->cfg.adc[1] >> 8);
+	*p++ = (uint8_t)n->cfg.adc[1];
+	stats.pushed++;
+	send_frame( sim_now() + out, d, (uint16_t)(p - d) );
+}
+
+static void apply_settings(_xbee_node *n)
+{
+	bool start = n->ir_set && n->ir != n->ir_set;
+
+	n->dio_out = n->dio_set;
+	n->dh = n->dh_set;
+	n->dl = n->dl_set;
+	n->ir = n->ir_set;
+	if ( start )
+		sim_schedule( sim_now() + SIM_MS(n->ir), ev_push, n, ++n->push_gen );
+}
+
+static void remote_at(const uint8_t *f, uint16_t len)
+{
+	uint8_t frame_id = f[1];
+	uint32_t SH = get32(f + 2), SL = get32(f + 6);
+	uint16_t cmd = AT(f[13], f[14]);
+	_xbee_node *n = find_node(SH, SL);
+	uint8_t resp[40], *p, status = XBEE_STATUS_OK;
+	uint64_t t = sim_now(), out, back;
+	bool apply = ( f[12] & 0x02 ) != 0;
+
+	(void)len;
+	if ( n && n->sleeps && cycling && !awake )
+		t = next_wake;
+	out = n ? deliver(n) : 0;
+
+	p = resp;
+	*p++ = API_REMOTE_RESPONSE;
+	*p++ = frame_id;
+	p = put32(p, SH);
+	p = put32(p, SL);
+	*p++ = 0xFF;
+	*p++ = 0xFE;
+	*p++ = f[13];
+	*p++ = f[14];
+
+	if ( !out )  {
+		stats.failed++;
+		if ( frame_id )  {
+			*p++ = XBEE_STATUS_TX_FAILED;
+			send_frame( t + SIM_MS((uint64_t)net.attempts * net.retry_ms), resp, (uint16_t)(p - resp) );
+		}
+		return;
+	}
+
+	// the command reached the node
+	switch ( cmd )  {
+		case AT('D','8'):
+		case AT('D','9'):
+			if ( len > 15 && f[15] == 0x05 )
+				n->dio_set |= (1 << (f[14] - '8'));
+			else
+				n->dio_set &= ~(1 << (f[14] - '8'));
+		break;
+
+		case AT('D','H'):
+			if ( len >= 19 )
+				n->dh_set = get32(f + 15);
+		break;
+
+		case AT('D','L'):
+			if ( len >= 19 )
+				n->dl_set = get32(f + 15);
+		break;
+
+		case AT('I','R'):
+			if ( len >= 17 )
+				n->ir_set = (uint16_t)((f[15] << 8) | f[16]);
+		break;
+
+		case AT('A','C'):
+			apply = true;
+		break;
+
+		case AT('S','M'):
+			n->sleeps = true;
+		break;
+	}
+	if ( apply )
+		apply_settings(n);
+	if ( !frame_id )
+		return;
+
+	*p++ = status;
+	if ( cmd == AT('I','S') )  {
+		*p++ = 0x01;							// one sample set
+		*p++ = 0x00;							// digital mask: DIO1, 4, 6, 7
+		*p++ = 0xD2;
+		*p++ = 0x0C;							// analog mask: AD2, AD3
+		*p++ = 0x00;							// digital samples
+		*p++ = dip_to_dio(n->cfg.dip);
+		*p++ = (uint8_t)(n->cfg.adc[0] >> 8);
+		*p++ = (uint8_t)n->cfg.adc[0];
+		*p++ = (uint8_t)(n->cfg.adc[1] >> 8);
+		*p++ = (uint8_t)n->cfg.adc[1];
+	}
+
+	back = deliver(n);
+	if ( back )
+		send_frame( t + out + SIM_MS(XBEE_NODE_PROCESS_MS) + back, resp, (uint16_t)(p - resp) );
+}
+
+static void rx_frame(void)
+{
+	uint16_t len = (uint16_t)((rx[1] << 8) | rx[2]);
+	uint8_t sum = 0;
+	uint16_t i;
+
+	stats.frames_in++;
+	for ( i = 0; i <= len; i++ )
+		sum += rx[3 + i];
+	if ( sum != 0xFF )  {
+		stats.bad_frames++;
+		return;
+	}
+	if ( rx[3] == API_LOCAL_AT && len >= 4 )
+		local_at( rx + 3, len );
+	else if ( rx[3] == API_REMOTE_AT && len >= 15 )
+		remote_at( rx + 3, len );
+}
+
+static void tx_byte(void *ctx, uint8_t byte, uint64_t start, uint64_t end)
+{
+	(void)ctx;
+	(void)start;
+	(void)end;
+	if ( rx_len == 0 && byte != 0x7E )
+		return;
+	rx[rx_len++] = byte;
+	if ( rx_len >= 3 )  {
+		uint16_t len = (uint16_t)((rx[1] << 8) | rx[2]);
+		if ( len + 4 > (uint16_t)sizeof(rx) )
+			rx_len = 0;
+		else if ( rx_len == len + 4 )  {
+			rx_frame();
+			rx_len = 0;
+		}
+	}
+}
+
+/*
+ * Public
+ */
+
+void xbee_net_init(const _xbee_net_cfg *cfg)
+{
+	if ( cfg )
+		net = *cfg;
+	rng = net.seed ? net.seed : 1;
+	sim_uart_tx_hook( SIM_UART_XBEE, tx_byte, NULL );
+}
+
+bool xbee_net_add(const _xbee_node_cfg *node)
+{
+	_xbee_node *n;
+
+	if ( node_count >= XBEE_NET_MAX_NODES )
+		return false;
+	n = &nodes_sim[node_count++];
+	memset(n, 0, sizeof(*n));
+	n->cfg = *node;
+	if ( !n->cfg.hops )
+		n->cfg.hops = 1;
+	if ( !n->cfg.hop_ms )
+		n->cfg.hop_ms = 15;
+	return true;
+}
+
+const _xbee_net_stats *xbee_net_stats(void)
+{
+	return &stats;
+}
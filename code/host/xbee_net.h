@@ -0,0 +1,77 @@
+//*****************************************************************************
+//	Header file for simulated DigiMesh network - SDI-12 bridge simulator
+//
+//	Plays the part of the coordinator XBee on USART1 and of the remote node
+//	 radios behind it. API frames sent by the firmware are decoded as they
+//	 leave the USART; local AT commands (0x08) are answered with 0x88, remote
+//	 AT commands (0x17) are delivered over a modelled mesh and answered with
+//	 0x97, nodes set up with IR push 0x92 IO samples, and the network sleep
+//	 cycle is reported with 0x8A modem status frames. Responses are serialized onto the USART1 receive line at the
+//	 programmed baud rate, as the real radio would.
+//*****************************************************************************
+
+#ifndef XBEE_NET_H
+#define XBEE_NET_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#define XBEE_NET_MAX_NODES		64
+
+// Delivery status in 0x97 frames
+#define XBEE_STATUS_OK			0x00
+#define XBEE_STATUS_ERROR		0x01
+#define XBEE_STATUS_TX_FAILED	0x04
+
+typedef struct
+{
+	uint32_t	SH, SL;				// 64-bit serial number
+	uint8_t		dip;				// DIP switch setting (SDI-12 address), 0..15
+	uint8_t		hops;				// hops from the coordinator, at least 1
+	uint16_t	hop_ms;				// one-way latency per hop
+	float		loss;				// probability one transmission attempt is lost
+	uint16_t	adc[2];				// values returned for AD2 and AD3 in IS samples
+} _xbee_node_cfg;
+
+typedef struct
+{
+	uint32_t	seed;				// random seed for loss and ND response times
+	uint16_t	nt_ms;				// ND response window (NT)
+	uint16_t	local_ms;			// local AT command turnaround
+	uint8_t		attempts;			// delivery attempts before TX failure
+	uint16_t	retry_ms;			// wait before each retry
+	bool		stay_awake;			// never report network sleep (benchmarks)
+} _xbee_net_cfg;
+
+typedef struct
+{
+	uint32_t	frames_in;			// API frames received from the firmware
+	uint32_t	bad_frames;			// ...with a checksum error
+	uint32_t	frames_out;			// API frames sent to the firmware
+	uint32_t	lost;				// transmission attempts lost
+	uint32_t	failed;				// remote commands reported as TX failure
+	uint32_t	pushed;				// IO samples pushed by nodes (0x92)
+} _xbee_net_stats;
+
+/*
+ * Description: Attach the network to USART1. Call before sim_run().
+ * Input: network parameters, NULL for defaults (NT 13 s, 3 attempts)
+ * Output: none
+ */
+void xbee_net_init(const _xbee_net_cfg *cfg);
+
+/*
+ * Description: Add a remote node. It answers ND and remote AT commands.
+ * Input: node parameters; zero hops or hop_ms take the defaults (1 hop, 15 ms)
+ * Output: false if the network is full
+ */
+bool xbee_net_add(const _xbee_node_cfg *node);
+
+/*
+ * Description: Counters for the current run.
+ * Input: none
+ * Output: pointer to the counters
+ */
+const _xbee_net_stats *xbee_net_stats(void);
+
+#endif
@@ -18,7 +18,8 @@ TODO:
  1) "Node Discovery" (ND) command is sent to XBee network. Each node responds at a random
  	time with a	packet containing it's address. This address is stored in temp_nodes[]. The
 	array index is sequential: first is zero, second is one, etc.
- 2) For each node in temp_nodes, do these steps in order:
+ 2) For each node in temp_nodes, do these steps in order. Nodes go through them
+ 	independently of each other, each at the pace of its own responses:
  	-Initialize IO on the Xbee with appropriate inputs and pullups.
 	-Sample Xbee IO. This returns the SDI-12 address from the SIP switch. The SDI-12 address
 	is used as the array index of nodes[].
@@ -52,8 +53,11 @@ All the while, network is responsive to incoming SDI-12 data requests.
 #include <stdio.h>
 #include <stdbool.h>
 #include <avr/wdt.h>
-#include "RingBuff.h"
-#include "dogm.h"
+#include "display.h"
+#include "energy.h"
+#include "format.h"
+#include "wake.h"
+#include "timer.h"
 #include "sdi12.h"
 #include "nodes.h"
 #include "main.h"
@@ -72,34 +76,197 @@ _ADC_sample ADC_sample;
 // The SDI-12 address is node_ids[current_node].
 uint8_t current_node;
 
+// Pipelined sampling: the pipeline state to return to after an incoming message
+// (zero when not pipelining), and IS requests still waiting for a response.
+uint8_t pipeline_state;
+uint8_t samples_outstanding;
+
+// Transmit queue space one pipeline pass needs (two probe pin frames)
+#define PIPE_TX_ROOM	(2 * WIRELESS_FRAME_MAX)
+
+// Transmit queue space one initialization step needs: a single frame,
+//  except DH and DL together with push sampling (see wireless_initialize_IO)
+#define INIT_TX_ROOM	((SAMPLING_PUSH ? 2 : 1) * WIRELESS_FRAME_MAX)
+
 // Vars for Rx ISR
 volatile bool next_byte_is_len1;
 volatile bool next_byte_is_len2;
+volatile bool receiving_frame;
 volatile uint16_t xbee_incoming_length;
 volatile uint8_t current_byte;
 volatile uint32_t checksum;
+volatile uint8_t rx_last_ms;			// low byte of clock_ms() at the last byte received
+
+// A received frame was parsed in the last pass of the main loop
+bool frame_parsed;
+uint8_t resume_state;			// state interrupted by the frame being parsed
 
-// Vars for timer
-volatile uint16_t overflows;
-uint16_t overflow_counter;
+// Sleep countdown on the display
 uint16_t seconds;
-volatile bool timer_done;
 
 // Vars for state machine
 bool initialized;
-volatile uint8_t init_status = IO_UNINITIALIZED;
 bool newly_asleep = true;
+bool wake_resend;				// wake_time changed while the network slept
 volatile uint8_t state = kWSN_StatNodeDiscovery;
 
+// Rolling node summary (SAMPLING_FAST)
+bool display_rolling;			// network awake, summary showing
+uint8_t display_next;			// node_ids[] index shown next
+
 // functions
-void start_timer(uint16_t counts);
-void reset_timer();
 void initialize();
+void start_discovery();
+void display_done_sampling();
+void display_sample(uint8_t ID, uint16_t ADC1, uint16_t ADC2);
+void display_summary();
+void next_node(uint16_t display_delay);
+bool loop_idle(bool display_done);
+uint8_t pipeline_message(uint8_t next_state);
+
+void display_done_sampling()
+{
+	char mAh[10];
+
+	display_rolling = false;
+	if ( HEADLESS )
+		return;
+	display_clear();
+	display_puts("Done sampling");
+	if ( energy_cycles )  {
+		display_gotoxy(0,1);
+		display_puts( energy_format_mAh(energy_last.total_nAh, mAh) );
+		display_puts("mAh/cycle");
+	}
+}
+
+// Count in the window and averages on the first line, after the address,
+//  and the given sample below
+void display_sample(uint8_t ID, uint16_t ADC1, uint16_t ADC2)
+{
+	char lcd_string[10];
+
+	if ( HEADLESS )
+		return;
+	display_gotoxy(2,0);
+	format_fixed(lcd_string, nodes[ID].probe[0].count, 0, 0);
+	display_puts(lcd_string);
+	display_puts("of");
+	format_fixed(lcd_string, node_window, 0, 0);
+	display_puts(lcd_string);
+	display_puts(" Avg");
+
+	if( nodes[ID].probe[0].count < 10 )
+		display_puts(" ");
+
+	// Display average values
+	format_fixed(lcd_string, node_calculate_average(ID,0), 0, 0);
+	display_puts(lcd_string);
+	format_fixed(lcd_string, node_calculate_average(ID,1), 0, 0);
+	display_gotoxy(12,1);
+	display_puts(lcd_string);
+
+	// Display sampled values
+	display_gotoxy(0,1);
+	format_fixed(lcd_string, ADC1, 0, 0);
+	display_puts(lcd_string);
+	display_puts(",");
+	format_fixed(lcd_string, ADC2, 0, 0);
+	display_puts(lcd_string);
+}
+
+// Next node of the rolling summary, with its last valid sample
+void display_summary()
+{
+	char lcd_string[4];
+	uint8_t ID;
+
+	timer_start( TIMER_DISPLAY, DISPLAY_REFRESH );
+	if ( HEADLESS || number_of_nodes == 0 )
+		return;
+	if ( display_next >= number_of_nodes )
+		display_next = 0;
+	ID = node_ids[display_next++];
+
+	display_clear();
+	format_fixed(lcd_string, ID, 0, 0);
+	display_puts(lcd_string);
+	display_sample( ID, node_last_sample(ID,0), node_last_sample(ID,1) );
+}
+
+// Serial polling: on to the next node, after a pause to read the display
+//  unless sampling fast or there is no display
+void next_node(uint16_t display_delay)
+{
+	if ( SAMPLING_FAST || HEADLESS )  {
+		current_node++;
+		state = kWSN_StatSampling;
+		return;
+	}
+	timer_start( TIMER_STATE, display_delay );
+	state = kWSN_StatNextNode;
+}
+
+// State after a message parsed while pipelining. Samples are stored by
+//  kWSN_StatSampleReady, which then resumes the pipeline; network sleep ends
+//  it. Anything else (late acks, packet errors) is ignored.
+uint8_t pipeline_message(uint8_t next_state)
+{
+	switch ( next_state )  {
+		case kWSN_StatSampleReady:
+			if ( nodes[ADC_sample.node].samples_pending )  {
+				nodes[ADC_sample.node].samples_pending--;
+				samples_outstanding--;
+				return kWSN_StatSampleReady;
+			}
+			return pipeline_state;				// not asked for this round
+
+		case kWSN_StatAsleep:
+			pipeline_state = 0;
+			newly_asleep = true;
+			return kWSN_StatAsleep;
+
+		default:
+			return pipeline_state;
+	}
+}
+
+// True when the next pass would find nothing to do: every state listed
+//  only waits for a timer, a received frame or the SDI-12 side, all of
+//  which arrive by interrupt. Called with interrupts disabled.
+bool loop_idle(bool display_done)
+{
+	if ( !display_done || frame_parsed || sdi12_msg_signal != 0xff )
+		return false;
+	if ( wireless_message_waiting() || sdi12_task_pending() )
+		return false;
+
+	switch ( state )  {
+		case kWSN_StatAsleep:
+			return !newly_asleep;
+		case kWSN_StatWaitingForMessage:
+		case kWSN_StatDoneSampling:
+		case kWSN_StatWarmup:
+		case kWSN_StatProbeWarmup:
+		case kWSN_StatNextNode:
+		case kWSN_StatNodeDiscovery:
+		case kWSN_StatDiscoveryDone:
+		case kWSN_StatPipeWarmup:
+		case kWSN_StatPipeCollect:
+		case kWSN_StatRestored:
+		case kWSN_StatStartup:
+			return true;
+	}
+	return false;
+}
 
 int main()
 {
 	sdi12_msg_signal = 0xff;
 	char lcd_string[10];
+	uint8_t i, nodes_left, next_state;
+	bool display_done;
+	_temp_node *t;
 	DDRB = (1<<DDB0);
 	initialize();
 
@@ -111,74 +278,228 @@ int main()
 	//	-Timer 1
 	//	-Pin change on SDI-12 bus.
 		sdi12_dotask();
+		display_done = display_task();
+		if ( SAMPLING_FAST && !HEADLESS && display_rolling && timer_expired(TIMER_DISPLAY) )
+			display_summary();
 		if ( sdi12_msg_signal != 0xff ) {
-			//dogm_clear();
+			//display_clear();
 
+			// CRC variant first: a non-zero sdi12_DataPtr releases the SRQ
+			sdi12_DataCRCPtr = nodes[sdi12_msg_signal].response_crc;
 			sdi12_DataPtr = node_prep_SDI12_msg(sdi12_msg_signal);
 			sdi12_msg_signal = 0xff;
-			//dogm_puts(sdi12_DataPtr);
+			//display_puts(sdi12_DataPtr);
+		}
+
+	// Timed out requests are resent while an answer can still come back
+	//  within the wake window. Initialization has no window.
+		wireless_retry_requests( initialized ? wake_left() : 0xFFFF );
+
+	// Received frames are parsed in order, one per pass. The state a frame
+	//  leads to always runs once before the next frame is taken.
+		if ( frame_parsed )
+			frame_parsed = false;
+		else if ( wireless_message_waiting() )  {
+			resume_state = state;
+			state = kWSN_StatMessageWaiting;
 		}
 
 	// Main WSN state machine
 		switch ( state )  {
 
-			//During normal program flow, this state exits when RX ISR sets state to kWSN_StatMessageWaiting
+			//During normal program flow, this state exits when a received frame sets state to kWSN_StatMessageWaiting.
+			// The request is resent on a timeout (see wireless_retry_requests); it is only
+			// gone unanswered once its retries, or the wake window, have run out.
 			case kWSN_StatWaitingForMessage:
-				if ( timer_done )  {
-					dogm_clear();
-					dogm_puts( "No response!" );
+				if ( !wireless_requests_pending() )  {
+					if ( !SAMPLING_FAST )  {
+						display_clear();
+						display_puts( "No response!" );
+					}
 
 					// Log error
 					nodes[node_ids[current_node]].UART_timeouts++;
-					start_timer(DISPLAY_DELAY_SHORT);
-					state = kWSN_StatNextNode;
+					next_node(DISPLAY_DELAY_SHORT);
 				}
 			break;
 
 			case kWSN_StatPacketError:
 				// Log error
 				nodes[node_ids[current_node]].Packet_errors++;
-				dogm_puts( "Packet error!" );
-				start_timer(DISPLAY_DELAY_SHORT);
-				state = kWSN_StatNextNode;
+				if ( !SAMPLING_FAST )
+					display_puts( "Packet error!" );
+				next_node(DISPLAY_DELAY_SHORT);
 			break;
 
 			case kWSN_StatMessageWaiting:
+				frame_parsed = true;
+				next_state = wireless_parse_message( initialized );
+				if ( next_state == kWSN_StatFrameDropped )  {
+					state = resume_state;
+					break;
+				}
+				if ( pipeline_state )  {
+					state = pipeline_message( next_state );
+					break;
+				}
 				//Turn off timer, because a message was received. Timer isn't
 				// used during initialization routine.
 				if ( initialized ) {
-					reset_timer();
+					timer_stop( TIMER_STATE );
 				}
-				state = wireless_parse_message( initialized );
+				state = next_state;
 			break;
 
 			case kWSN_StatBeforeSampling:
-				dogm_clear();
-				dogm_puts("Network awake");
-				start_timer( NETWORK_AWAKE_DELAY );
+				energy_set( ENERGY_RADIO, true );
+				display_clear();
+				display_puts("Network awake");
+				timer_start( TIMER_STATE, NETWORK_AWAKE_DELAY );
+				if ( wake_resend )  {
+					wireless_set_wake_time( wake_time );
+					wake_resend = false;
+				}
+				wake_start();
+				// pushed samples arrive all through the wake window
+				if ( SAMPLING_PUSH )
+					pipeline_state = kWSN_StatWarmup;
 				state = kWSN_StatWarmup;
 			break;
 
 			case kWSN_StatWarmup:
-				if ( timer_done )  {
-					state = kWSN_StatSampling;
+				if ( timer_expired(TIMER_STATE) )  {
+					if ( SAMPLING_FAST && !HEADLESS )  {
+						display_rolling = true;
+						timer_start( TIMER_DISPLAY, DISPLAY_REFRESH );
+					}
+					if ( SAMPLING_PIPELINED )  {
+						display_clear();
+						display_puts("Sampling all");
+						current_node = 0;
+						pipeline_state = kWSN_StatPipeProbesOn;
+						state = kWSN_StatPipeProbesOn;
+					}
+					else
+						state = kWSN_StatSampling;
+				}
+			break;
+
+			// Pipelined sampling. Each pass sends to one node and leaves state
+			//  alone, so a message arriving meanwhile is not overwritten.
+			//  Frames are only queued when the transmit queue has room for
+			//  them, so the main loop never waits on the UART.
+			case kWSN_StatPipeProbesOn:
+				if ( UART1_tx_free() < PIPE_TX_ROOM )
+					break;
+				if ( current_node < number_of_nodes )
+					wireless_set_probes( node_ids[current_node++], true );
+				else  {
+					timer_start( TIMER_STATE, SAMPLE_DELAY );
+					pipeline_state = kWSN_StatPipeWarmup;
+					state = kWSN_StatPipeWarmup;
+				}
+			break;
+
+			case kWSN_StatPipeWarmup:
+				if ( timer_expired(TIMER_STATE) )  {
+					current_node = 0;
+					samples_outstanding = 0;
+					if ( SAMPLING_PUSH )  {
+						// nothing to send: take the next sample each node pushes
+						for ( current_node = 0; current_node < number_of_nodes; current_node++ )  {
+							nodes[node_ids[current_node]].samples_pending = 1;
+							samples_outstanding++;
+						}
+						timer_start( TIMER_STATE, PUSH_TIMEOUT );
+						pipeline_state = kWSN_StatPipeCollect;
+						state = kWSN_StatPipeCollect;
+						break;
+					}
+					pipeline_state = kWSN_StatPipeSampling;
+					state = kWSN_StatPipeSampling;
+				}
+			break;
+
+			// A request waits for a free entry in the request table rather
+			//  than push out the oldest one, which would give it up
+			case kWSN_StatPipeSampling:
+				if ( UART1_tx_free() < PIPE_TX_ROOM || wireless_requests_pending() >= REQ_SLOTS )
+					break;
+				if ( current_node < number_of_nodes )  {
+					nodes[node_ids[current_node]].samples_pending++;
+					samples_outstanding++;
+					wireless_sample_DIO( node_ids[current_node] );
+					current_node++;
+				}
+				else  {
+					pipeline_state = kWSN_StatPipeCollect;
+					state = kWSN_StatPipeCollect;
+				}
+			break;
+
+			// Sample requests are resent until answered or given up; pushed
+			//  samples are waited for until PUSH_TIMEOUT
+			case kWSN_StatPipeCollect:
+				if ( samples_outstanding == 0 || (SAMPLING_PUSH ? timer_expired(TIMER_STATE) : !wireless_requests_pending()) )  {
+					// nodes that never answered
+					for ( current_node = 0; current_node < number_of_nodes; current_node++ )  {
+						if ( nodes[node_ids[current_node]].samples_pending )  {
+							nodes[node_ids[current_node]].UART_timeouts++;
+							nodes[node_ids[current_node]].samples_pending = 0;
+						}
+					}
+					timer_stop( TIMER_STATE );
+					current_node = 0;
+					pipeline_state = kWSN_StatPipeProbesOff;
+					state = kWSN_StatPipeProbesOff;
+				}
+			break;
+
+			case kWSN_StatPipeProbesOff:
+				if ( UART1_tx_free() < PIPE_TX_ROOM )
+					break;
+				if ( current_node < number_of_nodes )
+					wireless_set_probes( node_ids[current_node++], false );
+				else  {
+					if ( wake_done(true) )
+						wireless_set_wake_time( wake_time );
+					// a restored node silent for too long: the saved node
+					//  table does not match the network
+					if ( node_table_stale() )  {
+						node_table_forget();
+						start_discovery();
+						break;
+					}
+					display_done_sampling();
+					newly_asleep = true;
+					pipeline_state = SAMPLING_PUSH ? kWSN_StatDoneSampling : 0;
+					state = kWSN_StatDoneSampling;
 				}
 			break;
 
 			case kWSN_StatSampling:
 				if ( current_node < number_of_nodes )  {	// 0-index, haven't sampled all the probes yet
-					dogm_clear();
-					itoa(node_ids[current_node], lcd_string, 10);
-					dogm_puts(lcd_string);
+					if ( !SAMPLING_FAST && !HEADLESS )  {
+						display_clear();
+						format_fixed(lcd_string, node_ids[current_node], 0, 0);
+						display_puts(lcd_string);
+					}
 
-					start_timer( UART_TIMEOUT );
 					state = kWSN_StatWaitingForMessage;
 
 					wireless_turn_on_probes(node_ids[current_node]);
 				}
 				else  {		// All probes have been sampled
-					dogm_clear();
-					dogm_puts("Done sampling");
+					if ( wake_done(true) )
+						wireless_set_wake_time( wake_time );
+					// a restored node silent for too long: the saved node
+					//  table does not match the network
+					if ( node_table_stale() )  {
+						node_table_forget();
+						start_discovery();
+						break;
+					}
+					display_done_sampling();
 
 					newly_asleep = true;
 					state = kWSN_StatDoneSampling;
@@ -187,76 +508,46 @@ int main()
 
 			// Probes are on, so start warmup timer
 			case kWSN_StatProbesOn:
-				start_timer( SAMPLE_DELAY );
+				timer_start( TIMER_STATE, SAMPLE_DELAY );
 				state = kWSN_StatProbeWarmup;
 			break;
 
 			case kWSN_StatProbeWarmup:
-				if ( timer_done )  {	//Warmup timer has expired
-					start_timer( UART_TIMEOUT );
+				if ( timer_expired(TIMER_STATE) )  {	//Warmup timer has expired
 					state = kWSN_StatWaitingForMessage;
-					wireless_sample_DIO( nodes[node_ids[current_node]].SL, nodes[node_ids[current_node]].SH );
+					wireless_sample_DIO( node_ids[current_node] );
 				}
 			break;
 
 			case kWSN_StatSampleReady:
-				if ( node_validate_sample(ADC_sample.ADC1) )  {
-					nodes[ADC_sample.node].probe[0].data[nodes[ADC_sample.node].current_sample] = ADC_sample.ADC1;
-					node_incr_data_count( ADC_sample.node, 0 );
-				}
-				else  {
-					nodes[ADC_sample.node].probe[0].data[nodes[ADC_sample.node].current_sample] = 0;
-					node_decr_data_count( ADC_sample.node, 0 );
-				}
-
-				if ( node_validate_sample(ADC_sample.ADC2) )  {
-					nodes[ADC_sample.node].probe[1].data[nodes[ADC_sample.node].current_sample] = ADC_sample.ADC2;
-					node_incr_data_count( ADC_sample.node, 1 );
-				}
-				else  {
-					nodes[ADC_sample.node].probe[1].data[nodes[ADC_sample.node].current_sample] = 0;
-					node_decr_data_count( ADC_sample.node, 1 );
+				// invalid samples stay out of the statistics
+				if ( node_validate_sample(ADC_sample.ADC1) )
+					node_add_sample( ADC_sample.node, 0, ADC_sample.ADC1 );
+				if ( node_validate_sample(ADC_sample.ADC2) )
+					node_add_sample( ADC_sample.node, 1, ADC_sample.ADC2 );
+
+				// sampling fast, the rolling summary shows it
+				if ( !SAMPLING_FAST )
+					display_sample( ADC_sample.node, ADC_sample.ADC1, ADC_sample.ADC2 );
+
+				// Format the aD0! responses now, off the SDI-12 critical path
+				node_sample_stored(ADC_sample.node);
+
+				if ( pipeline_state )  {
+					state = pipeline_state;
+					break;
 				}
 
-				dogm_gotoxy(2,0);
-				//Plus one to convert from 0-indexed array to 1 through 16
-				itoa(nodes[node_ids[current_node]].current_sample + 1, lcd_string, 10);
-				dogm_puts(lcd_string);
-				dogm_puts("of16 Avg");
-
-				if( nodes[node_ids[current_node]].current_sample + 1 < 10 )
-					dogm_puts(" ");
-
-				// Display average values
-				itoa(node_calculate_average(ADC_sample.node,0), lcd_string, 10);
-				dogm_puts(lcd_string);
-				itoa(node_calculate_average(ADC_sample.node,1), lcd_string, 10);
-				dogm_gotoxy(12,1);
-				dogm_puts(lcd_string);
-
-				// Display sampled values
-				dogm_gotoxy(0,1);
-				itoa(ADC_sample.ADC1, lcd_string, 10);
-				dogm_puts(lcd_string);
-				dogm_puts(",");
-				itoa(ADC_sample.ADC2, lcd_string, 10);
-				dogm_puts(lcd_string);
-
-				// Increment current_sample for the current_node
-				node_incr_sample_idx(ADC_sample.node);
-
-				start_timer( UART_TIMEOUT );
 				state = kWSN_StatWaitingForMessage;
 				wireless_turn_off_probes( node_ids[current_node] );
 			break;
 
 			case kWSN_StatProbesOff:
-				start_timer( DISPLAY_DELAY );
-				state = kWSN_StatNextNode;
+				next_node( DISPLAY_DELAY );
 			break;
 
 			case kWSN_StatNextNode:
-				if ( timer_done )  {
+				if ( timer_expired(TIMER_STATE) )  {
 					current_node++;
 					state = kWSN_StatSampling;
 				}
@@ -267,89 +558,139 @@ int main()
 			break;
 
 			case kWSN_StatAsleep:
+				// slept before sampling finished: the window was too short
+				if ( wake_done(false) )
+					wake_resend = true;
+
 				if ( newly_asleep )  {
-					seconds = SLEEP_SECONDS;
-					start_timer( OVERFLOWS_PER_SECOND );
-					dogm_clear();
-					dogm_puts("Network asleep");
-					dogm_gotoxy(0,1);
-					dogm_puts("Awake in:");
-					dogm_gotoxy(14,1);
-					dogm_putc('s');
+					energy_set( ENERGY_RADIO, false );
+					energy_end_cycle();
+					display_rolling = false;
 					current_node = 0;
 					newly_asleep = false;
+					// the countdown is only there to be read
+					if ( HEADLESS )
+						break;
+					seconds = SLEEP_SECONDS;
+					timer_start( TIMER_DISPLAY, 1000 );
+					display_clear();
+					display_puts("Network asleep");
+					display_gotoxy(0,1);
+					display_puts("Awake in:");
+					display_gotoxy(14,1);
+					display_putc('s');
 				}
-				else if ( timer_done )  {
-					start_timer( OVERFLOWS_PER_SECOND );
+				else if ( !HEADLESS && timer_expired(TIMER_DISPLAY) )  {
+					timer_start( TIMER_DISPLAY, 1000 );
 					seconds = seconds - 1;
-					dogm_gotoxy(10,1);
+					display_gotoxy(10,1);
 					if ( seconds < 1000 && seconds >= 100 )
-						dogm_putc('0');
+						display_putc('0');
 					else if ( seconds < 100 && seconds >= 10 )
-						dogm_puts("00");
+						display_puts("00");
 					else if ( seconds < 10 )
-						dogm_puts("000");
-					itoa(seconds, lcd_string, 10);
-					dogm_puts(lcd_string);
+						display_puts("000");
+					format_fixed(lcd_string, seconds, 0, 0);
+					display_puts(lcd_string);
 				}
 			break;
 
 			case kWSN_StatNodeDiscovery:
-				if ( timer_done )  {
+				if ( timer_expired(TIMER_STATE) )  {
 					if ( number_of_nd_nodes == 0 ) {
-						dogm_clear();
-						dogm_puts("No nodes found!");
-						dogm_gotoxy(0,1);
-						dogm_puts("restarting...");
+						display_clear();
+						display_puts("No nodes found!");
+						display_gotoxy(0,1);
+						display_puts("restarting...");
 						//wdt_enable(WDTO_120MS);
 					}
-					else  {
-						dogm_clear();
-						dogm_puts("ND Done!");
-						_delay_ms(1000);
-						dogm_clear();
-						dogm_puts("Reading SDI-12");
-						dogm_gotoxy(0,1);
-						dogm_puts("Adresses:");
-						overflows = 0;
+					else if ( HEADLESS )
 						state = UNINITIALIZED;
-						// start timer for assigning SDI-12 addresses - if it timeouts, restart
+					else  {
+						display_clear();
+						display_puts("ND Done!");
+						timer_start( TIMER_STATE, 1000 );
+						state = kWSN_StatDiscoveryDone;
 					}
 				}
 			break;
 
-			// This is Xbee-specific
+			// "ND Done!" stays up for a second before initialization starts
+			case kWSN_StatDiscoveryDone:
+				if ( timer_expired(TIMER_STATE) )  {
+					display_clear();
+					display_puts("Reading SDI-12");
+					display_gotoxy(0,1);
+					display_puts("Adresses:");
+					state = UNINITIALIZED;
+				}
+			break;
+
+			// This is Xbee-specific. Every discovered node is brought up at
+			//  once: a node with no step outstanding is sent its next one,
+			//  and responses advance the node they come from (see
+			//  init_response in wireless_xbee.c). Unanswered steps are
+			//  resent by wireless_retry_requests, which fails the node once
+			//  its retries run out.
 			case UNINITIALIZED:
-				if ( number_of_nodes <  number_of_nd_nodes )  {
-					switch ( init_status )  {
+				nodes_left = 0;
+				for ( i = 0; i < number_of_nd_nodes; i++ )  {
+					t = &temp_nodes[i];
+					if ( t->init_status == NODE_READY || t->init_status == NODE_FAILED )
+						continue;
+					nodes_left++;
+					if ( t->frame_ID || UART1_tx_free() < INIT_TX_ROOM )
+						continue;
+					// a full request table would give up, and so fail, the
+					//  node waiting longest
+					if ( wireless_requests_pending() >= REQ_SLOTS )
+						continue;
+					wireless_init_step(i);
+				}
 
-						//Message has been sent; expecting a response
-						case INIT_WAITING:
-						break;
+				if ( nodes_left )
+					break;
+				display_clear();
+				display_puts("Starting sleep");
+				// a node that failed is looked for again at the next power-up
+				if ( number_of_nodes == number_of_nd_nodes )
+					node_table_save();
+				else
+					node_table_forget();
+				initialized = true;
+				wireless_start_sleep();
+				// the coordinator has its sleep settings before the bridge
+				//  counts as up; SDI-12 is not served yet, so nothing waits
+				UART1_flush();
+				sdi12_init();
+				state = kWSN_StatDoneSampling;
+			break;
 
-						case IO_UNINITIALIZED:
-							init_status = INIT_WAITING;
-							wireless_initialize_IO(temp_nodes[number_of_nodes].SL,temp_nodes[number_of_nodes].SH);
-						break;
-						case ADDR_UNINITIALIZED:
-							init_status = INIT_WAITING;
-							wireless_sample_DIO(temp_nodes[number_of_nodes].SL,temp_nodes[number_of_nodes].SH);
-						break;
-						case ADDR_INITIALIZED:
-							init_status = INIT_WAITING;
-							wireless_start_network_sleep(temp_nodes[number_of_nodes].SL,temp_nodes[number_of_nodes].SH);
-					}
-				}
-				else {
-					dogm_clear();
-					dogm_puts("Starting sleep");
-					_delay_ms(500);
-					initialized = true;
+			// Warm restart. SDI-12 is already served from the restored table;
+			//  the coordinator is set up for network sleep once the XBee has
+			//  started. A frame arriving first means it kept running through
+			//  the reset, settings and all.
+			case kWSN_StatRestored:
+				if ( timer_expired(TIMER_STATE) )  {
 					wireless_start_sleep();
-					sdi12_init();
 					state = kWSN_StatDoneSampling;
 				}
 			break;
+
+			// Cold start: the XBee is given time to start before discovery
+			case kWSN_StatStartup:
+				if ( timer_expired(TIMER_STATE) )
+					start_discovery();
+			break;
+		}
+
+	// Nothing left to do until the next interrupt: sleep. The check runs
+	//  with interrupts off so an event can't slip in between it and sleep.
+		if ( IDLE_SLEEP )  {
+			cli();
+			if ( loop_idle(display_done) )
+				timer_sleep();
+			sei();
 		}
 	}
 }
@@ -357,38 +698,75 @@ int main()
 // This is XBee-specific
 ISR(USART1_RX_vect)
 {
+	uint8_t status = UCSR1A;				// read before UDR1, which clears it
 	uint8_t ReceivedByte = UDR1;
-	current_byte++;
+	uint8_t now = (uint8_t)clock_ms();
+	bool gap = (uint8_t)(now - rx_last_ms) > RX_GAP_MS;
 
-	if ( next_byte_is_len2 )  {
-		xbee_incoming_length = ReceivedByte;
-		next_byte_is_len2 = false;
-		checksum = 0;
+	rx_last_ms = now;
+
+	// API mode 1 does not escape data, so a 0x7E inside a frame is data and
+	//  the frame can only be given up some other way: a receive error or a
+	//  pause means bytes are missing. A byte with a framing error is noise.
+	if ( receiving_frame && (gap || (status & ((1<<FE1)|(1<<DOR1)))) )  {
+		receiving_frame = false;
+		xbee_rx_aborts++;
 	}
-	else if ( next_byte_is_len1 )  {
+	if ( status & (1<<FE1) )
+		return;
+
+	if ( !receiving_frame )  {
+		if ( ReceivedByte == API_start_delimiter )  {
+			receiving_frame = true;
+			next_byte_is_len1 = true;
+			current_byte = 1;
+		}
+		return;
+	}
+	current_byte++;
+
+	if ( next_byte_is_len1 )  {
+		xbee_incoming_length = ReceivedByte << 8;
 		next_byte_is_len1 = false;
 		next_byte_is_len2 = true;
+		return;
 	}
-	else if ( ReceivedByte == API_start_delimiter )  {
-		next_byte_is_len1 = true;
-		xbee_incoming_length = 0;
-		current_byte = 1;
-		BUFF_InitialiseBuffer();
+	if ( next_byte_is_len2 )  {
+		xbee_incoming_length |= ReceivedByte;
+		next_byte_is_len2 = false;
+		checksum = 0;
+		// no frame the bridge takes is this long: more likely a data 0x7E
+		//  taken for the delimiter after bytes were lost
+		if ( xbee_incoming_length == 0 || xbee_incoming_length >= RX_FRAME_MAX )  {
+			receiving_frame = false;
+			xbee_rx_aborts++;
+		}
+		return;
 	}
-	else
-		checksum += ReceivedByte;
 
-	BUFF_StoreBuffByte(ReceivedByte);
+	// frame data and checksum follow the delimiter and two length bytes
+	checksum += ReceivedByte;
+	if ( (uint8_t)(current_byte - 4) < RX_FRAME_MAX )
+		xbee_rx_frames[xbee_rx_head].data[current_byte - 4] = ReceivedByte;
 
 	if ( current_byte == xbee_incoming_length + 4 )  {
+		receiving_frame = false;
 		if( (uint8_t) checksum == 0xFF )  {
-  			state = kWSN_StatMessageWaiting;
+			// queue the frame; the main loop takes it when it is ready
+			if ( RX_NEXT_SLOT(xbee_rx_head) != xbee_rx_tail )  {
+				xbee_rx_frames[xbee_rx_head].len = xbee_incoming_length;
+				xbee_rx_head = RX_NEXT_SLOT(xbee_rx_head);
+			}
+			else
+				xbee_rx_overflows++;
 		}
 	}
 }
 
 void initialize()
 {
+	char lcd_string[4];
+
 	// read reset flags
 	if ( MCUSR ) {
 		uint8_t temp = MCUSR;
@@ -402,55 +780,63 @@ void initialize()
 	/* Turn off WDT */
 	//WDTCSR = 0x00;
 
-	// setup timer prescaler (divide by 1024)
-	TCCR0B = (1<<CS02) | (1<<CS00);
-
-	// initialize ring buffer for UART1 Rx interrupt
-	BUFF_InitialiseBuffer();
+	// the millisecond clock also clocks the energy ledger
+	energy_init();
+	timer_init();
 
 	uart_init();
 
-	dogm_init();
-	dogm_clear();
-	dogm_puts("Starting up...");
-	_delay_ms(2000);
-	dogm_clear();
-	dogm_puts("Node Discovery");
-	dogm_gotoxy(0, 1);
-	dogm_puts("Found:");
+	display_init();
+
+	// Saved node table: no discovery. The table is checked by the wake
+	//  cycles that follow; restored nodes have to answer with their DIP
+	//  setting within NODE_SILENT_CYCLES of them.
+	if ( node_table_restore() )  {
+		if ( !HEADLESS )  {
+			display_puts("Restored nodes:");
+			display_gotoxy(0, 1);
+			format_fixed(lcd_string, number_of_nodes, 0, 0);
+			display_puts(lcd_string);
+		}
+		sei();
+		initialized = true;
+		sdi12_init();
+		timer_start( TIMER_STATE, STARTUP_DELAY );
+		state = kWSN_StatRestored;
+		return;
+	}
 
-	// set timer0 for node discovery
+	display_puts("Starting up...");
 	sei();
-	start_timer(ND_PERIOD);
-
-	// issue node_discover command - response is handled by RX1 interrupt
-	wireless_node_discover();
+	timer_start( TIMER_STATE, STARTUP_DELAY );
+	state = kWSN_StatStartup;
 }
 
-void start_timer(uint16_t counts)
+// Discovery from scratch: at power-up without a saved node table, or
+//  when the restored one turned out not to match the network
+void start_discovery()
 {
-	overflow_counter = counts;
-	overflows = 0;
-	timer_done = false;
-	TIMSK0 |= (1<<TOIE0);
-}
+	number_of_nd_nodes = 0;
+	number_of_nodes = 0;
+	initialized = false;
+	pipeline_state = 0;
+	display_rolling = false;
 
-void reset_timer()
-{
-	timer_done = false;
-	overflows = 0;
-	TIMSK0 &= ~(1<<TOIE0);
-}
+	display_clear();
+	display_puts("Node Discovery");
+	display_gotoxy(0, 1);
+	display_puts("Found:");
 
-ISR(TIMER0_OVF_vect)
-{
-	overflows++;
+	// node discovery period
+	timer_start( TIMER_STATE, ND_PERIOD );
 
-	if (overflows >= overflow_counter) {
-		timer_done = true;
-		overflows = 0;
-		TIMSK0 &= ~(1<<TOIE0);
-	}
+	// nodes pushing samples need the bridge's address
+	if ( SAMPLING_PUSH )
+		wireless_read_address();
+
+	// issue node_discover command - response is handled by RX1 interrupt
+	wireless_node_discover();
+	state = kWSN_StatNodeDiscovery;
 }
 
 void wd_start(void)
@@ -23,18 +23,71 @@
 #define kWSN_StatNextNode				13
 #define kWSN_StatPacketError			14
 #define kWSN_StatNodeDiscovery			15
+#define kWSN_StatPipeProbesOn			16
+#define kWSN_StatPipeWarmup				17
+#define kWSN_StatPipeSampling			18
+#define kWSN_StatPipeCollect			19
+#define kWSN_StatPipeProbesOff			20
+#define kWSN_StatFrameDropped			21		// frame needs no state change: resume the state it interrupted
+#define kWSN_StatRestored				22		// node table restored from EEPROM, XBee starting up
+#define kWSN_StatStartup				23		// no saved node table, XBee starting up
+#define kWSN_StatDiscoveryDone			24		// showing the discovery result
 #define UNINITIALIZED 					0
 
 
 
-#define SAMPLE_DELAY					20						// delay between turning probes on and reading ADC
-#define NETWORK_AWAKE_DELAY				100						// delay between "network woke up message" and starting to sample probes
-#define DISPLAY_DELAY					200
-#define DISPLAY_DELAY_SHORT				40
-#define ND_PERIOD						1000
+// Waits, msec (see timer.h)
+#define SAMPLE_DELAY					330						// delay between turning probes on and reading ADC
+#define NETWORK_AWAKE_DELAY				1640					// delay between "network woke up message" and starting to sample probes
+#define DISPLAY_DELAY					3280
+#define DISPLAY_DELAY_SHORT				660
+#define DISPLAY_REFRESH					1000					// rolling node summary
+#define ND_PERIOD						16380
+#define STARTUP_DELAY					2000					// XBee start-up after power-up
 
-#define OVERFLOWS_PER_SECOND 			61
-#define UART_TIMEOUT					200
+// Pipelined sampling powers every node's probes, runs one shared SAMPLE_DELAY
+//  warmup and then has an IS request outstanding to every node at once, so the
+//  wake time needed follows the slowest node instead of the sum of all nodes.
+//  false restores strictly serial per-node polling.
+#ifndef SAMPLING_PIPELINED
+#define SAMPLING_PIPELINED				true
+#endif
+
+// Push sampling: nodes are set up to send an IO sample (0x92) to the bridge
+//  every SAMPLE_PUSH_INTERVAL ms while the network is awake, so the bridge
+//  sends no IS requests and only listens after the probe warmup. Samples
+//  pushed outside that window are discarded; a longer interval saves node
+//  airtime but lengthens the wait for the first sample. Needs
+//  SAMPLING_PIPELINED.
+#ifndef SAMPLING_PUSH
+#define SAMPLING_PUSH					false
+#endif
+#ifndef SAMPLE_PUSH_INTERVAL
+#define SAMPLE_PUSH_INTERVAL			1000					// msec, node IR setting
+#endif
+
+// Fast sampling: serial polling moves to the next node as soon as the last
+//  one is done, instead of pausing DISPLAY_DELAY (DISPLAY_DELAY_SHORT after
+//  an error) for the display to be read. While the network is awake the
+//  display shows each node's summary in turn, one every DISPLAY_REFRESH,
+//  rather than every sample as it arrives. false restores the pauses.
+#ifndef SAMPLING_FAST
+#define SAMPLING_FAST					true
+#endif
+
+// Idle sleep: a main loop pass that finds nothing to do puts the MCU in
+//  idle mode until the next interrupt - a received byte on either USART,
+//  the 1 ms timer, Timer1 or an SDI-12 line change. false keeps it spinning.
+#ifndef IDLE_SLEEP
+#define IDLE_SLEEP						true
+#endif
+
+#if SAMPLING_PUSH && !SAMPLING_PIPELINED
+#error "SAMPLING_PUSH needs SAMPLING_PIPELINED"
+#endif
+
+#define UART_TIMEOUT					3280					// msec
+#define PUSH_TIMEOUT					( UART_TIMEOUT + SAMPLE_PUSH_INTERVAL )
 
 #define NO_SLEEP_MESSAGES				false
 #define SEND_SLEEP_MESSAGES				true
@@ -62,7 +115,6 @@ typedef struct
 // GLOBAL VARIABLES
 
 
-extern volatile 	uint8_t init_status;
 extern _ADC_sample	ADC_sample;
 
 
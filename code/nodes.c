@@ -10,70 +10,332 @@
 //*****************************************************************************
 
 #include <string.h>
+#include <stdlib.h>
+#include <avr/eeprom.h>
 #include "main.h"
 #include "wireless_xbee.h"
 #include "nodes.h"
-
-//char array that will hold the response message to the host data logger
-char SDI12_string[35];
+#include "sdi12.h"
+#include "crc16.h"
+#include "format.h"
 
 uint16_t SDI12counter = 0;
 
-void node_incr_sample_idx( uint8_t node_ID )
+// Samples in the statistics window, 1 to DATA_BUFFER_SIZE
+uint8_t node_window = DATA_BUFFER_SIZE;
+
+// Saved node table, in node_ids[] order
+typedef struct
 {
-	if ( nodes[node_ID].current_sample >= (DATA_BUFFER_SIZE - 1)  )
-		nodes[node_ID].current_sample = 0;
-	else
-		nodes[node_ID].current_sample++;
+	uint8_t		version;				// NODE_RECORD_VERSION
+	uint8_t		count;					// number_of_nodes
+	struct
+	{
+		uint8_t		ID;
+		uint32_t	SL;
+		uint32_t	SH;
+	} node[NODE_ARRAY_SIZE];
+	uint16_t	crc;					// CRC-16 of the fields above
+} _node_record;
+
+static _node_record EEMEM node_record;
+
+bool node_validate_sample(uint16_t sample)
+{
+	//if ( sample != 0x03FF && sample != 0x0000 )
+	//	return true;
+	//else
+	//	return false;
+	return sample <= SAMPLE_MAX;			// keeps the sum of squares within 32 bits
 }
 
-void node_incr_data_count( uint8_t node_ID, uint8_t probe_ID )
+// Sample 'back' places before the newest one
+static uint16_t probe_sample(_probe *p, uint8_t back)
 {
-	if ( nodes[node_ID].probe[probe_ID].num_good_samples < DATA_BUFFER_SIZE )
-		nodes[node_ID].probe[probe_ID].num_good_samples++;
+	int8_t idx = (int8_t)p->head - 1 - back;
+
+	if ( idx < 0 )
+		idx += DATA_BUFFER_SIZE;
+	return p->data[idx];
 }
 
-void node_decr_data_count( uint8_t node_ID, uint8_t probe_ID )
+static void probe_rescan(_probe *p)
 {
-	if ( nodes[node_ID].probe[probe_ID].num_good_samples > 1)
-		nodes[node_ID].probe[probe_ID].num_good_samples--;
+	uint16_t v;
+	uint8_t i;
+
+	p->min = SAMPLE_MAX;
+	p->max = 0;
+	for ( i = 0; i < p->count; i++ )  {
+		v = probe_sample(p, i);
+		if ( v < p->min )
+			p->min = v;
+		if ( v > p->max )
+			p->max = v;
+	}
 }
 
-bool node_validate_sample(uint16_t sample)
+void node_add_sample(uint8_t node_ID, uint8_t probe_ID, uint16_t sample)
 {
-	//if ( sample != 0x03FF && sample != 0x0000 )
-		return true;
-	//else
-	//	return false;
+	_probe *p = &nodes[node_ID].probe[probe_ID];
+	bool rescan = false;
+	uint16_t old;
+
+	if ( p->count >= node_window )  {		// oldest sample leaves the window
+		old = probe_sample(p, node_window - 1);
+		p->sum -= old;
+		p->sum_sq -= (uint32_t)old * old;
+		p->count--;
+		rescan = ( old == p->min || old == p->max );
+	}
+
+	p->data[p->head] = sample;
+	p->head = ( p->head + 1 == DATA_BUFFER_SIZE ) ? 0 : p->head + 1;
+	if ( p->stored < DATA_BUFFER_SIZE )
+		p->stored++;
+	p->count++;
+	p->sum += sample;
+	p->sum_sq += (uint32_t)sample * sample;
+
+	// the EMA runs over every sample, not the window: a window of one
+	//  must not reseed it each time
+	if ( p->stored == 1 )
+		p->ema = sample << NODE_EMA_SHIFT;
+	else
+		p->ema += (int16_t)((sample << NODE_EMA_SHIFT) - p->ema) >> NODE_EMA_SHIFT;
+
+	if ( p->count == 1 )  {
+		p->min = sample;
+		p->max = sample;
+	}
+	else if ( rescan )
+		probe_rescan(p);
+	else  {
+		if ( sample < p->min )
+			p->min = sample;
+		if ( sample > p->max )
+			p->max = sample;
+	}
+}
+
+// Changes the window and rebuilds every probe's statistics from the samples
+//  it has kept. Responses are reformatted at the next hand-off.
+void node_set_window(uint8_t length)
+{
+	_probe *p;
+	uint8_t node_ID, probe_ID, i;
+
+	if ( length < 1 )
+		length = 1;
+	if ( length > DATA_BUFFER_SIZE )
+		length = DATA_BUFFER_SIZE;
+	node_window = length;
+
+	for ( node_ID = 0; node_ID < NODE_ARRAY_SIZE; node_ID++ )  {
+		for ( probe_ID = 0; probe_ID < 2; probe_ID++ )  {
+			p = &nodes[node_ID].probe[probe_ID];
+			p->count = ( p->stored < length ) ? p->stored : length;
+			p->sum = 0;
+			p->sum_sq = 0;
+			for ( i = 0; i < p->count; i++ )  {
+				p->sum += probe_sample(p, i);
+				p->sum_sq += (uint32_t)probe_sample(p, i) * probe_sample(p, i);
+			}
+			probe_rescan(p);
+		}
+		nodes[node_ID].response_stale = true;
+	}
 }
 
 uint16_t node_calculate_average(uint8_t ID, uint8_t probe)
 {
-	uint16_t sum = 0;
-	uint16_t avg = 0;
+	if ( nodes[ID].probe[probe].count == 0 )
+		return 0;
+	return nodes[ID].probe[probe].sum / nodes[ID].probe[probe].count;
+}
+
+// Population standard deviation, rounded down
+uint16_t node_stddev(uint8_t ID, uint8_t probe)
+{
+	_probe *p = &nodes[ID].probe[probe];
+	uint32_t var, bit, root = 0;
 
-	for ( uint8_t avg_idx = 0; avg_idx < 16; avg_idx++ )  {
-			sum += nodes[ID].probe[probe].data[avg_idx];
+	if ( p->count < 2 )
+		return 0;
+	// n^2 * variance; both terms stay below 2^32 for 16 10-bit samples
+	var = p->count * p->sum_sq - p->sum * p->sum;
+
+	// integer square root, a fixed 16 steps
+	for ( bit = 1UL << 30; bit; bit >>= 2 )  {
+		if ( var >= root + bit )  {
+			var -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
 	}
-	if ( nodes[ID].probe[probe].num_good_samples > 0 )
-		avg = sum / nodes[ID].probe[probe].num_good_samples;
-	else
-		avg = 0;
+	return root / p->count;
+}
+
+uint16_t node_range(uint8_t ID, uint8_t probe)
+{
+	if ( nodes[ID].probe[probe].count == 0 )
+		return 0;
+	return nodes[ID].probe[probe].max - nodes[ID].probe[probe].min;
+}
+
+uint16_t node_ema(uint8_t ID, uint8_t probe)
+{
+	return nodes[ID].probe[probe].ema >> NODE_EMA_SHIFT;
+}
+
+// Most recent valid sample, 0 if there is none yet
+uint16_t node_last_sample(uint8_t ID, uint8_t probe)
+{
+	_probe *p = &nodes[ID].probe[probe];
+
+	if ( !p->stored )
+		return 0;
+	return p->data[(p->head + DATA_BUFFER_SIZE - 1) % DATA_BUFFER_SIZE];
+}
 
-	return avg;
+// SDI-12 address of the initialized node with this serial number, or NODE_NOT_FOUND
+uint8_t node_find(uint32_t SL, uint32_t SH)
+{
+	uint8_t i;
+
+	for ( i = 0; i < number_of_nodes; i++ )
+		if ( nodes[node_ids[i]].SL == SL && nodes[node_ids[i]].SH == SH )
+			return node_ids[i];
+	return NODE_NOT_FOUND;
+}
+
+// SDI-12 address character of a node, the inverse of the mapping in sdi12.c
+static char node_address_char(uint8_t node_ID)
+{
+	if ( node_ID < 10 )
+		return '0' + node_ID;
+	if ( node_ID < 0x24 )
+		return 'A' + node_ID - 0x0A;
+	return 'a' + node_ID - 0x34;
+}
+
+// Builds both aD0! responses of a node, with and without CRC, so answering
+//  the data logger is only a pointer hand-off
+void node_format_response(uint8_t node_ID)
+{
+	char *msg = nodes[node_ID].response;
+	char *crc = nodes[node_ID].response_crc;
+	uint8_t len = 1;
+
+	msg[0] = node_address_char(node_ID);
+	len += format_fixed( &msg[len], node_calculate_average(node_ID, 0), 0, FORMAT_SIGN );
+	len += format_fixed( &msg[len], node_calculate_average(node_ID, 1), 0, FORMAT_SIGN );
+
+	memcpy(crc, msg, len);
+	crc16_sdi12_chars( crc16_update_str(CRC16_INIT, msg), &crc[len] );
+	memcpy(&crc[len + 3], "\r\n", 3);
+	memcpy(&msg[len], "\r\n", 3);
+	nodes[node_ID].response_stale = false;
+}
+
+// New sample stored. A response already handed to the SDI-12 module is left
+//  alone until the data logger has collected it.
+void node_sample_stored(uint8_t node_ID)
+{
+	if ( sdi12_DataPtr == nodes[node_ID].response )
+		nodes[node_ID].response_stale = true;
+	else
+		node_format_response(node_ID);
 }
 
 char* node_prep_SDI12_msg(uint8_t node_ID)
 {
-	strcpy(SDI12_string, "d+");
-	char avg[8];
+	if ( nodes[node_ID].response_stale || !nodes[node_ID].response[0] )
+		node_format_response(node_ID);
+	return nodes[node_ID].response;
+}
 
-	itoa(node_calculate_average(node_ID, 0),avg,10);
-	strcat(SDI12_string, avg);
-	strcat(SDI12_string, "+");
-	itoa(node_calculate_average(node_ID, 1),avg,10);
-	strcat(SDI12_string, avg);
-	return SDI12_string;
+static uint16_t node_record_crc(const _node_record *r)
+{
+	const uint8_t *p = (const uint8_t *)r;
+	uint16_t crc = CRC16_INIT;
+
+	while ( p < (const uint8_t *)&r->crc )
+		crc = crc16_update(crc, *p++);
+	return crc;
+}
+
+// Only bytes that differ are programmed, so saving an unchanged table
+//  costs no EEPROM writes
+void node_table_save(void)
+{
+	_node_record r;
+	uint8_t i;
+
+	memset(&r, 0, sizeof(r));
+	r.version = NODE_RECORD_VERSION;
+	r.count = number_of_nodes;
+	for ( i = 0; i < number_of_nodes; i++ )  {
+		r.node[i].ID = node_ids[i];
+		r.node[i].SL = nodes[node_ids[i]].SL;
+		r.node[i].SH = nodes[node_ids[i]].SH;
+	}
+	r.crc = node_record_crc(&r);
+	eeprom_update_block(&r, &node_record, sizeof(r));
+}
+
+// Restored nodes are marked until they answer (see node_unverified)
+bool node_table_restore(void)
+{
+	_node_record r;
+	uint8_t i, ID;
+
+	eeprom_read_block(&r, &node_record, sizeof(r));
+	if ( r.version != NODE_RECORD_VERSION || r.count == 0 || r.count > NODE_ARRAY_SIZE
+			|| r.crc != node_record_crc(&r) )
+		return false;
+	for ( i = 0; i < r.count; i++ )
+		if ( r.node[i].ID >= NODE_ARRAY_SIZE )
+			return false;
+
+	for ( i = 0; i < r.count; i++ )  {
+		ID = r.node[i].ID;
+		node_ids[i] = ID;
+		nodes[ID].SL = r.node[i].SL;
+		nodes[ID].SH = r.node[i].SH;
+		nodes[ID].DIP_setting = ID;
+		nodes[ID].restored = true;
+		nodes[ID].silent_cycles = 0;
+	}
+	number_of_nodes = r.count;
+	return true;
+}
+
+// The saved table no longer matches the network: invalidate it, so the
+//  next power-up runs discovery, and drop the restored marks
+void node_table_forget(void)
+{
+	uint8_t i;
+
+	eeprom_update_byte(&node_record.version, 0xFF);
+	for ( i = 0; i < NODE_ARRAY_SIZE; i++ )
+		nodes[i].restored = false;
 }
 
+// End of a wake cycle's sampling. A restored node that has not yet
+//  answered with its own address and DIP setting may only have missed
+//  the cycle, so it is given NODE_SILENT_CYCLES before the saved table is
+//  taken not to match the network.
+bool node_table_stale(void)
+{
+	uint8_t i;
+	_node *n;
 
+	for ( i = 0; i < number_of_nodes; i++ )  {
+		n = &nodes[node_ids[i]];
+		if ( n->restored && ++n->silent_cycles >= NODE_SILENT_CYCLES )
+			return true;
+	}
+	return false;
+}
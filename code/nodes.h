@@ -8,19 +8,41 @@
 #ifndef NODES_H
 #define NODES_H
 
-#define DATA_BUFFER_SIZE  16
+#define DATA_BUFFER_SIZE  16			// samples kept per probe, and the longest window
+#define SAMPLE_MAX        0x03FF		// XBee ADC readings are 10 bits
+#ifndef NODE_EMA_SHIFT
+#define NODE_EMA_SHIFT    3				// EMA weight of a new sample is 1/2^NODE_EMA_SHIFT
+#endif
+#define RESPONSE_SIZE     20			// "a+nnnnn+nnnnnCCC\r\n" and terminator
+#ifndef NODE_ARRAY_SIZE
 #define NODE_ARRAY_SIZE   10
+#endif
 
 typedef struct
 {
   	uint32_t SL;               // Serial number low
   	uint32_t SH;               // Serial number high
+  	uint8_t  init_status;      // next initialization step, or NODE_READY / NODE_FAILED
+  	uint8_t  frame_ID;         // of the step sent and not yet answered, 0 if none
+  	uint8_t  io_param;         // IO settings sent so far, ahead of AC
+  	uint8_t  ID;               // SDI-12 address, once the DIP switch is read
 } _temp_node;
 
+// Rolling statistics over the last node_window valid samples. Sums are kept
+//  as samples enter and leave the window, so every statistic is read in
+//  constant time; min and max are rescanned only when the sample leaving
+//  the window held one of them.
 typedef struct
 {
-	uint16_t	data[DATA_BUFFER_SIZE];
-	uint8_t		num_good_samples;
+	uint16_t	data[DATA_BUFFER_SIZE];		// last DATA_BUFFER_SIZE valid samples
+	uint8_t		head;						// where the next sample goes
+	uint8_t		stored;						// valid samples in data[]
+	uint8_t		count;						// samples in the window
+	uint32_t	sum;						// of the samples in the window
+	uint32_t	sum_sq;
+	uint16_t	min;
+	uint16_t	max;
+	uint16_t	ema;						// exponential moving average, NODE_EMA_SHIFT fraction bits
 } _probe;
 
 typedef struct
@@ -28,21 +50,55 @@ typedef struct
   	uint32_t 	SL;               			// Serial number low
   	uint32_t 	SH;               			// Serial number high
   	_probe	 	probe[2];
-  	uint8_t 	current_sample;				// Index of current sample in data array
   	uint16_t 	UART_timeouts;				// Data quality check: number of UART timeouts
+  	uint16_t 	retries;					// Data quality check: requests resent after a timeout
   	uint16_t 	Packet_errors;				// Data quality check: number of packet errors
   	uint16_t 	CRC_errors;					// Data quality check: number of checksum errors
   	uint8_t 	DIP_setting;				// DIP switch setting. Also equal to the SDI-12 address.
+  	uint8_t 	samples_pending;			// IS requests not yet answered (pipelined sampling)
+  	bool		response_stale;				// new data since the responses were formatted
+  	bool		restored;					// from the saved node table, not yet heard from
+  	uint8_t		silent_cycles;				// wake cycles ended with it restored and unheard
+  	char		response[RESPONSE_SIZE];	// aD0! response, formatted when a sample lands
+  	char		response_crc[RESPONSE_SIZE];// aD0! response after aMC! or aCC!
 } _node;
 
+#define NODE_NOT_FOUND	0xFF
+
+// The node table (node_ids[] and each node's address) is saved in EEPROM
+//  once initialization has brought up every discovered node, and restored
+//  at power-up instead of running discovery. Bump the version when the
+//  record changes.
+#define NODE_RECORD_VERSION	1
+// A restored node that misses this many wake cycles in a row is taken
+//  to be gone, and the table rebuilt by discovery
+#ifndef NODE_SILENT_CYCLES
+#define NODE_SILENT_CYCLES	3
+#endif
+
 extern _temp_node 	temp_nodes[NODE_ARRAY_SIZE];
 extern _node 		nodes[NODE_ARRAY_SIZE];
 extern uint8_t 		node_ids[NODE_ARRAY_SIZE];
 extern uint8_t 		number_of_nodes;
 extern uint8_t 		number_of_nd_nodes;
 
-void node_incr_sample_idx(uint8_t ID);
+extern uint8_t 		node_window;
+
+bool node_validate_sample(uint16_t sample);
+void node_add_sample(uint8_t ID, uint8_t probe, uint16_t sample);
+void node_set_window(uint8_t length);
 char * node_prep_SDI12_msg(uint8_t ID);
+void node_format_response(uint8_t ID);
+void node_sample_stored(uint8_t ID);
+uint8_t node_find(uint32_t SL, uint32_t SH);
 uint16_t node_calculate_average(uint8_t ID, uint8_t probe);
+uint16_t node_stddev(uint8_t ID, uint8_t probe);
+uint16_t node_range(uint8_t ID, uint8_t probe);
+uint16_t node_ema(uint8_t ID, uint8_t probe);
+uint16_t node_last_sample(uint8_t ID, uint8_t probe);
+void node_table_save(void);
+bool node_table_restore(void);
+void node_table_forget(void);
+bool node_table_stale(void);
 
 #endif
@@ -2000,6 +2000,21 @@ void sdi12_RxBufClr( void ) //-PRIVATE
 	sdi12_RxIndx = 0;
 	} //sdi12_RxBufClr( void )
 
+//******************************************************
+//bool sdi12_task_pending( void ) PUBLIC
+// True while a received command waits for sdi12_dotask()
+//	to parse it. The host checks it, with interrupts off,
+//	before putting the MCU to sleep.
+//
+//	Variables modified or accessed
+//		sdi12_flags		global PRIVATE
+//
+//******************************************************
+bool sdi12_task_pending( void ) //PUBLIC
+	{
+	return ( sdi12_flags & kSDI12_RxCmd ) != 0;
+	} //end sdi12_task_pending( void )
+
 //******************************************************
 //void sdi12_dotask( void ) PUBLIC
 // This is one of the public API functions of the sdi12
@@ -2332,7 +2347,7 @@ void sdi12_dotask( void ) //PUBLIC
 			else if ( sdi12_RxBuf[1] == 'C' ) {
 				//4 char C must be followed by 'C' or {'1'-'9'}
 				if ( sdi12_RxBuf[2] == 'C') {
-					sdi12_send_m_atttn( sdi12_RxAddr );
+					sdi12_send_atttnn( sdi12_RxAddr );	//no concurrent values, as for 'C'
 					sdi12_flags = ( kSDI12_CRCFlg | kSDI12_CmdC | kSDI12_ProcCmd );	//set the M with CRC flag
 					sdi12_RxData = kSDI12_RxClr;	//nothing to add
 				}
@@ -2627,6 +2642,7 @@ void sdi12_send_abort_response( char a ) 	//PRIVATE called from sdi12_cmd_parse(
 //	Variables modified or accessed
 //		sdi12_msg_signal	global public
 //		sdi12_DataPtr		global PRIVATE
+//		sdi12_DataCRCPtr	global PRIVATE
 //		sdi12_SendData		global PRIVATE
 //		sdi12_TxBuf[]		global PRIVATE
 //
@@ -2634,12 +2650,6 @@ void sdi12_send_abort_response( char a ) 	//PRIVATE called from sdi12_cmd_parse(
 void sdi12_send_wireless( char a, char *msg, uint8_t control  ) 	//PRIVATE
 	{
 
-	char *StrPtr;	//The CRC scan pointer
-	uint16_t CRC;	//the CRC working var
-	uint16_t SCRC;	//shifter version of CRC for character assignment
-	uint8_t count;	//shift counter for CRC opertion
-	char Char1, Char2, Char3;
-
 	sdi12_msg_signal = 0xff; 	//reset it
 	if (sdi12_DataPtr == 0 ) {  //then wireless has not set it yet
 	    sdi12_TxBuf[0] = a; // 'a'
@@ -2654,46 +2664,12 @@ void sdi12_send_wireless( char a, char *msg, uint8_t control  ) 	//PRIVATE
 	} //end if empty sdi12_DataPtr
 
 	else { //there must be a wireless message to send
-		sdi12_DataPtr = msg; 	//the working data ptr
-		*sdi12_DataPtr = a;		//first becomes address
-		while (*sdi12_DataPtr > 0) { //scan for the first terminating null
-			sdi12_DataPtr++;
-			}
-		//sdi12_DataPtr now points to first terminator
-		//CRC goes here if requested!
-		if (control & kSDI12_CRCFlg ) { //then CRC has to be added!
-			StrPtr = msg;
-			while (*StrPtr != 0) {
-				CRC = CRC ^ *StrPtr;
-				StrPtr ++;
-				for ( count = 0; count < 8; count ++) {
-					if (CRC & 0x0001) {
-						CRC = CRC / 2;
-						CRC = CRC ^ 0xA001;
-					}
-					else
-						CRC = CRC / 2;
-				} //end for
-
-			} //end while
-
-			Char3 = 0x40 | (CRC & 0x003F); //'right-most CRC char
-			SCRC = CRC / 64; //right shift 6 times
-			Char2 = 0x40 | (SCRC & 0x003F); //middle CRC char
-			SCRC = SCRC / 64; //right shift 6 times
-			Char1 = 0x40 | (SCRC & 0x3F); //left-most CRC char
-			*sdi12_DataPtr = Char1;
-			sdi12_DataPtr ++;
-			*sdi12_DataPtr = Char2;
-			sdi12_DataPtr ++;
-			*sdi12_DataPtr = Char3;
-			sdi12_DataPtr ++;	//now points to location of CR
-		}
-		//now add the CR/LF
-		*sdi12_DataPtr = '\r';	//carriage return
-		sdi12_DataPtr ++;
-		*sdi12_DataPtr = '\n'; 	//line feed char
-		sdi12_SendPtr = msg;	//the start of the data string
+		//wireless formatted both responses, with and without CRC,
+		// when the sample arrived; just point to the right one
+		if (control & kSDI12_CRCFlg )
+			sdi12_SendPtr = sdi12_DataCRCPtr;
+		else
+			sdi12_SendPtr = msg;	//the start of the data string
 	}
 
 	#ifdef SDI12_DEBUG
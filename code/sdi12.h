@@ -13,6 +13,8 @@
 //**************************************************************
 #ifndef SDI12_H
  #define SDI12_H
+
+ #include <stdbool.h>
   
  #define SDI12_DEBUG	//controls inclusion of debugging statements
 
@@ -31,11 +33,13 @@
   uint8_t extern number_of_nodes; 	//declared in main module
   uint8_t extern node_ids[]; 		//declared in main module
   char * volatile sdi12_DataPtr;	//pointer to data message
+  char * volatile sdi12_DataCRCPtr; //pointer to the same data message with CRC
 
 //API function declarations
   void sdi12_init( void );	 	//PUBLIC  initializes sdi12 interface
   void sdi12_enable( void );	//PUBLIC  enables the sdi12 interface after being disabled
   void sdi12_disable( void );	//PUBLIC  disables the sdi12 interface
   void sdi12_dotask( void ); 	//PUBLIC  must be called regularly from main() to manage sdi12
+  bool sdi12_task_pending( void ); //PUBLIC  a command waits for sdi12_dotask(), do not sleep
 
 #endif /* !SDI12_H */
@@ -0,0 +1,107 @@
+//*****************************************************************************
+//	Software timer service for SDI-12 bridge project
+//
+//	See timer.h.
+//*****************************************************************************
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "timer.h"
+#include "energy.h"
+
+#if TIMER_TOP > 255
+#error "Timer0 cannot count a millisecond at this F_CPU and TIMER_PRESCALE"
+#endif
+
+static volatile uint32_t	clock_count;
+static volatile uint16_t	left[TIMER_HANDLES];		// ms to go, 0 when stopped
+static volatile uint8_t		expired;					// event flags, bit per handle
+
+void timer_init(void)
+{
+	TCCR0A = (1<<WGM01);								// CTC, TOP = OCR0A
+	OCR0A = TIMER_TOP;
+	TCNT0 = 0;
+	TCCR0B = (1<<CS01) | (1<<CS00);						// divide by 64
+	TIMSK0 = (1<<OCIE0A);
+}
+
+void timer_start(uint8_t handle, uint16_t ms)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	left[handle] = ms;
+	if ( ms )
+		expired &= ~(1 << handle);
+	else
+		expired |= (1 << handle);
+	SREG = sreg;
+}
+
+void timer_stop(uint8_t handle)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	left[handle] = 0;
+	expired &= ~(1 << handle);
+	SREG = sreg;
+}
+
+bool timer_expired(uint8_t handle)
+{
+	return ( expired & (1 << handle) ) != 0;
+}
+
+// Microseconds since timer_init(), to TIMER_PRESCALE / F_CPU resolution.
+//  Interrupts must be off; a compare match not yet taken is counted.
+static uint32_t clock_us(void)
+{
+	uint8_t count = TCNT0;
+	uint32_t us = clock_count * 1000 + (uint32_t)count * 1000 / (TIMER_TOP + 1);
+
+	// matched before TCNT0 was read, not just after
+	if ( (TIFR0 & (1<<OCF0A)) && count < (TIMER_TOP + 1) / 2 )
+		us += 1000;
+	return us;
+}
+
+// The interrupt that wakes the MCU runs before sleep_cpu() returns
+void timer_sleep(void)
+{
+	uint32_t start;
+
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	start = clock_us();
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+	cli();
+	energy_idle( clock_us() - start );
+	sei();
+}
+
+uint32_t clock_ms(void)
+{
+	uint8_t sreg = SREG;
+	uint32_t t;
+
+	cli();
+	t = clock_count;
+	SREG = sreg;
+	return t;
+}
+
+ISR(TIMER0_COMPA_vect)
+{
+	uint8_t handle;
+
+	clock_count++;
+	energy_tick();
+	for ( handle = 0; handle < TIMER_HANDLES; handle++ )
+		if ( left[handle] && --left[handle] == 0 )
+			expired |= (1 << handle);
+}
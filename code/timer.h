@@ -0,0 +1,78 @@
+//*****************************************************************************
+//	Header file for software timer service for SDI-12 bridge project
+//
+//	Timer0 runs in CTC mode and interrupts every millisecond. The interrupt
+//	 advances a free-running millisecond clock, clocks the energy ledger and
+//	 counts down TIMER_HANDLES independent timers. A timer that runs out sets
+//	 its event flag, which stays set until the timer is started or stopped
+//	 again; the main loop polls the flags, nothing runs in the interrupt.
+//
+//	When a main loop pass leaves nothing to do before the next interrupt,
+//	 timer_sleep() puts the MCU in idle mode. Every enabled interrupt wakes
+//	 it: USART0 and USART1 receive and transmit, Timer0 (at least once a
+//	 millisecond), Timer1 and PCINT3. The time asleep goes to the energy
+//	 ledger, whose MCU on time then gives the duty cycle.
+//
+//	Timer1 belongs to the SDI-12 driver.
+//*****************************************************************************
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// Handles
+#define TIMER_STATE					0			// the WSN state machine's waits
+#define TIMER_DISPLAY				1			// sleep countdown and rolling summary
+#define TIMER_HANDLES				2
+
+#define TIMER_PRESCALE				64
+#define TIMER_TOP					( F_CPU / TIMER_PRESCALE / 1000 - 1 )	// OCR0A for 1 ms
+
+/*
+ * Description: Start Timer0 and the millisecond clock, all timers stopped.
+ * Input: none
+ * Output: none
+ */
+void timer_init(void);
+
+/*
+ * Description: Start a timer, or restart it if it is running, and clear its
+ *				event flag. A timer started for 0 ms has run out at once.
+ * Input: handle, milliseconds
+ * Output: none
+ */
+void timer_start(uint8_t handle, uint16_t ms);
+
+/*
+ * Description: Stop a timer and clear its event flag.
+ * Input: handle
+ * Output: none
+ */
+void timer_stop(uint8_t handle);
+
+/*
+ * Description: Event flag of a timer.
+ * Input: handle
+ * Output: true once the timer has run out, until it is started or stopped
+ */
+bool timer_expired(uint8_t handle);
+
+/*
+ * Description: Sleep in idle mode until the next interrupt has been taken.
+ *				Call with interrupts disabled, after checking there is
+ *				nothing to do; returns with them enabled.
+ * Input: none
+ * Output: none
+ */
+void timer_sleep(void);
+
+/*
+ * Description: Free-running millisecond clock, for timestamps.
+ * Input: none
+ * Output: milliseconds since timer_init(), modulo 2^32 (about 49 days)
+ */
+uint32_t clock_ms(void);
+
+#endif
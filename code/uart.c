@@ -32,6 +32,7 @@
  */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <string.h>
 #include <stdbool.h>
 #include "uart.h"
@@ -50,77 +51,98 @@ void uart_init()
 
 /*
  *************************************
- *  USART1                           *
+ *  USART1 transmit queue            *
  *************************************
  */
 
-void UART1_Transmit(uint8_t data )
+// Bytes are queued here and moved to UDR1 by the data register empty
+//  interrupt, so a frame costs the main loop only the time to queue it.
+static volatile uint8_t UART1_tx_buffer[UART1_TX_BUFFER_SIZE];
+static volatile uint8_t UART1_tx_head;		// next free slot, written by main loop
+static volatile uint8_t UART1_tx_tail;		// next byte to send, written by ISR
+static bool UART1_tx_used;					// TXC1 is only meaningful once a byte was sent
+
+uint8_t UART1_tx_high_water;
+
+ISR(USART1_UDRE_vect)
 {
-  /* Wait for empty transmit buffer */
-  while ( !( UCSR1A & (1<<UDRE1)) )
-    ;
-  /* Put data into buffer, sends the data */
-  UDR1 = data;
+	if ( UART1_tx_tail == UART1_tx_head )  {
+		UCSR1B &= ~(1<<UDRIE1);				// queue empty
+		return;
+	}
+	UCSR1A |= (1<<TXC1);					// cleared here, set when the last byte is out
+	UDR1 = UART1_tx_buffer[UART1_tx_tail];
+	UART1_tx_tail = (UART1_tx_tail + 1) & (UART1_TX_BUFFER_SIZE - 1);
 }
 
-void UART1_Transmit_16bit(uint16_t data)
+uint8_t UART1_tx_free(void)
 {
-/* Wait for empty transmit buffer */
-while ( !( UCSR1A & (1<<UDRE1)) )
-;
-/* Put MSB of data into buffer, sends the data */
-UDR1 = (char)((data & 0xFF00)>>8);
+	return (UART1_TX_BUFFER_SIZE - 1) - ((UART1_tx_head - UART1_tx_tail) & (UART1_TX_BUFFER_SIZE - 1));
+}
 
-/* Wait for empty transmit buffer */
-while ( !( UCSR1A & (1<<UDRE1)) )
-;
+void UART1_tx_wait(uint8_t count)
+{
+	// UDRIE1 stays set until the ISR has emptied the queue
+	while ( UART1_tx_free() < count && (UCSR1B & (1<<UDRIE1)) )
+		;
+}
 
-/* Put LSB of data into buffer, sends the data */
+void UART1_flush(void)
+{
+	while ( UCSR1B & (1<<UDRIE1) )
+		;
+	if ( UART1_tx_used )
+		while ( !(UCSR1A & (1<<TXC1)) )
+			;
+}
 
-UDR1 = (data & 0x00FF);
+/*
+ *************************************
+ *  USART1                           *
+ *************************************
+ */
+
+void UART1_Transmit(uint8_t data )
+{
+	uint8_t head = (UART1_tx_head + 1) & (UART1_TX_BUFFER_SIZE - 1), used;
+
+	/* Wait for room in the queue */
+	while ( head == UART1_tx_tail && (UCSR1B & (1<<UDRIE1)) )
+		;
+	UART1_tx_buffer[UART1_tx_head] = data;
+	UART1_tx_head = head;
+	UART1_tx_used = true;
+
+	used = (head - UART1_tx_tail) & (UART1_TX_BUFFER_SIZE - 1);
+	if ( used > UART1_tx_high_water )
+		UART1_tx_high_water = used;
+
+	UCSR1B |= (1<<UDRIE1);
+}
+
+void UART1_Transmit_16bit(uint16_t data)
+{
+	UART1_Transmit( (uint8_t)(data >> 8) );
+	UART1_Transmit( (uint8_t)data );
 }
 
 void UART1_Transmit_32bit(uint32_t data)
 {
-  /* Wait for empty transmit buffer */
-  while ( !( UCSR1A & (1<<UDRE1)) )
-    ;
-  /* Put MSB_high of data into buffer, sends the data */
-  UDR1 = (uint8_t)((data & 0xFF000000)>>24);
-
-  /* Wait for empty transmit buffer */
-  while ( !( UCSR1A & (1<<UDRE1)) )
-    ;
-  /* Put MSB_low of data into buffer, sends the data */
-  UDR1 = (uint8_t)((data & 0x00FF0000)>>16);
-
-  /* Wait for empty transmit buffer */
-  while ( !( UCSR1A & (1<<UDRE1)) )
-    ;
-  /* Put LSB_high of data into buffer, sends the data */
-  UDR1 = (uint8_t)((data & 0x0000FF00)>>8);
-
-  /* Wait for empty transmit buffer */
-  while ( !( UCSR1A & (1<<UDRE1)) )
-    ;
-  
-  /* Put LSB_low of data into buffer, sends the data */
-  UDR1 = (uint8_t)(data & 0x000000FF);
+	UART1_Transmit( (uint8_t)(data >> 24) );
+	UART1_Transmit( (uint8_t)(data >> 16) );
+	UART1_Transmit( (uint8_t)(data >> 8) );
+	UART1_Transmit( (uint8_t)data );
 }
 
 uint8_t UART1_Receive( void )
 {
 	 /* Wait for data to be received */
 
-	TIMSK0 = (1<<TOIE0);
-
 	while ( !(UCSR1A & (1<<RXC1)) )  {
 
 		
 	}
 	return UDR1;
-	TIMSK0 &= ~(1<<TOIE0);
-	
 }
 
 void UART1_Transmit_string(char *string)
@@ -37,6 +37,20 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+/*
+ *************************************
+ *  Defines                          *
+ *************************************
+ */
+
+// USART1 transmit queue, a power of two. The largest XBee frame sent is
+//  WIRELESS_FRAME_MAX (23) bytes, so this holds several queued requests.
+#ifndef UART1_TX_BUFFER_SIZE
+#define UART1_TX_BUFFER_SIZE	128
+#endif
+
+// Most bytes ever waiting in the transmit queue
+extern uint8_t UART1_tx_high_water;
 
 /*
  *************************************
@@ -58,7 +72,8 @@ void uart_init();
  */
 
 /*
- * Description: Transmits uint8_t over UART1
+ * Description: Queues uint8_t for transmission over UART1. Returns at once
+ *              unless the queue is full, then waits for room.
  * Input: uint8_t - Data to be transmitted
  * Output: None
  */
@@ -72,6 +87,31 @@ uint8_t UART1_Receive();
 void UART1_Transmit_16bit(uint16_t data);
 void UART1_Transmit_32bit(uint32_t data);
 
+/*
+ * Description: Room left in the UART1 transmit queue
+ * Input: None
+ * Output: uint8_t - Bytes that can be queued without waiting
+ */
+uint8_t UART1_tx_free(void);
+
+/*
+ * Description: Waits until the UART1 transmit queue has room for a number
+ *              of bytes, so a whole frame can be queued without stalling
+ *              part way through
+ * Input: uint8_t - Bytes needed
+ * Output: None
+ */
+void UART1_tx_wait(uint8_t count);
+
+/*
+ * Description: Waits until every queued byte has left the UART1 shift
+ *              register, for when a frame must be at the XBee before
+ *              the bridge moves on (before a reset or sleep of either)
+ * Input: None
+ * Output: None
+ */
+void UART1_flush(void);
+
 /*
  * Description: Transmits a NULL-terminated string over UART1
  *              The string can be of arbitrary length.
@@ -0,0 +1,84 @@
+//*****************************************************************************
+//	Adaptive wake window for SDI-12 bridge project
+//
+//	See wake.h.
+//*****************************************************************************
+
+#include "wake.h"
+#include "timer.h"
+#include "main.h"
+
+uint16_t wake_time = WAKE_TIME;
+
+static uint16_t	history[WAKE_HISTORY];		// ms each cycle needed, oldest overwritten
+static uint8_t	history_next, history_count;
+static uint32_t	start_ms;
+static bool		timing;
+
+static void record(uint32_t ms)
+{
+	history[history_next] = ms > 0xFFFF ? 0xFFFF : ms;
+	history_next = ( history_next + 1 ) % WAKE_HISTORY;
+	if ( history_count < WAKE_HISTORY )
+		history_count++;
+}
+
+static uint16_t percentile(void)
+{
+	uint16_t sorted[WAKE_HISTORY], v;
+	uint8_t i, j;
+
+	for ( i = 0; i < history_count; i++ )  {
+		v = history[i];
+		for ( j = i; j && sorted[j - 1] > v; j-- )
+			sorted[j] = sorted[j - 1];
+		sorted[j] = v;
+	}
+	return sorted[ ((uint16_t)history_count * WAKE_PERCENTILE + 99) / 100 - 1 ];
+}
+
+void wake_start(void)
+{
+	start_ms = clock_ms();
+	timing = true;
+}
+
+bool wake_done(bool complete)
+{
+	uint32_t budget;
+	uint16_t drift;
+
+	if ( !timing )
+		return false;
+	timing = false;
+
+	if ( complete )
+		record( clock_ms() - start_ms );
+	else
+		record( 2UL * wake_time );
+
+	if ( !WAKE_ADAPTIVE || (complete && history_count < WAKE_HISTORY_MIN) )
+		return false;
+
+	budget = (uint32_t)percentile() * (100 + WAKE_MARGIN_PCT) / 100 + WAKE_MARGIN_MS;
+	if ( budget < WAKE_TIME_MIN )
+		budget = WAKE_TIME_MIN;
+	if ( budget > WAKE_TIME_MAX )
+		budget = WAKE_TIME_MAX;
+
+	drift = budget > wake_time ? budget - wake_time : wake_time - budget;
+	if ( drift <= wake_time / 8 )
+		return false;
+	wake_time = budget;
+	return true;
+}
+
+uint16_t wake_left(void)
+{
+	uint32_t used;
+
+	if ( !timing )
+		return 0;
+	used = clock_ms() - start_ms;
+	return used < wake_time ? wake_time - used : 0;
+}
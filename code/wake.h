@@ -0,0 +1,57 @@
+//*****************************************************************************
+//	Header file for adaptive wake window for SDI-12 bridge project
+//
+//	Measures each cycle's sampling, from the network waking up to
+//	 kWSN_StatDoneSampling, and sizes the network wake time (ST) from a
+//	 percentile of the last WAKE_HISTORY cycles plus a margin. A cycle cut
+//	 short by the network going back to sleep counts as needing twice the
+//	 window it had. ST is only changed when the budget drifts more than an
+//	 eighth away from the value in force, so it does not follow every cycle.
+//
+//	Durations are timed on the millisecond clock (timer.h).
+//*****************************************************************************
+
+#ifndef WAKE_H
+#define WAKE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#ifndef WAKE_ADAPTIVE
+#define WAKE_ADAPTIVE				true
+#endif
+
+#define WAKE_HISTORY				16			// cycles kept
+#define WAKE_HISTORY_MIN			4			// cycles before the first change
+#define WAKE_PERCENTILE				90
+#define WAKE_MARGIN_PCT				25			// budget = percentile * 1.25 + 2 s
+#define WAKE_MARGIN_MS				2000
+#define WAKE_TIME_MIN				5000		// ms
+#define WAKE_TIME_MAX				60000
+
+extern uint16_t wake_time;						// ST in force, ms
+
+/*
+ * Description: The network woke up; start timing the cycle.
+ * Input: none
+ * Output: none
+ */
+void wake_start(void);
+
+/*
+ * Description: End the cycle's timing and work out the budget.
+ * Input: true if sampling finished, false if the network slept first
+ * Output: true if wake_time changed and should be sent to the XBee; false
+ *		   also when no cycle was being timed
+ */
+bool wake_done(bool complete);
+
+/*
+ * Description: Time left before the network goes back to sleep, by the
+ *				wake time in force.
+ * Input: none
+ * Output: msec, 0 when no cycle is being timed
+ */
+uint16_t wake_left(void);
+
+#endif
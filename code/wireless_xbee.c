@@ -18,10 +18,14 @@
 #include <stdbool.h>
 #include "wireless_xbee.h"
 #include "main.h"
-#include "RingBuff.h"
+#include "timer.h"
 #include "nodes.h"
 #include "xbee_API.h"
-#include "dogm.h"
+#include "display.h"
+#include "energy.h"
+#include "format.h"
+#include "wake.h"
+#include "uart.h"
 
 /*
  * Error handling
@@ -36,11 +40,16 @@
  *
  */
 
-//We have to keep track of the probe state, because the response from the
-// remote node to the power on/power off command is identical.
-bool probes_on = false;
+_xbee_request xbee_requests[REQ_SLOTS];
 
-uint8_t frameID;
+// Received frame queue, filled by the USART1 receive ISR
+_xbee_frame xbee_rx_frames[RX_FRAME_SLOTS];
+volatile uint8_t xbee_rx_head;
+volatile uint8_t xbee_rx_tail;
+uint16_t xbee_rx_overflows;
+volatile uint16_t xbee_rx_aborts;
+
+uint32_t bridge_SH, bridge_SL;
 
 //Convert hardware DIP switch on remote node to SDI-12 address
 static uint8_t DIP_to_ID( uint8_t DIP_setting )
@@ -56,10 +65,159 @@ static uint8_t DIP_to_ID( uint8_t DIP_setting )
 	return new_id;
 }
 
+static const uint8_t retry_limit[] = { RETRY_PROBES, RETRY_SAMPLE, RETRY_INIT };
+static const uint8_t retry_backoff[] = { RETRY_PROBES_BACKOFF, RETRY_SAMPLE_BACKOFF, RETRY_INIT_BACKOFF };
+
+static uint16_t jitter_state = 0xACE1;
+
+// xorshift, 0 to range - 1
+static uint16_t jitter(uint16_t range)
+{
+	jitter_state ^= jitter_state << 7;
+	jitter_state ^= jitter_state >> 9;
+	jitter_state ^= jitter_state << 8;
+	return jitter_state % range;
+}
+
+static uint32_t request_SL(const _xbee_request *r)
+{
+	return r->policy == REQ_INIT ? temp_nodes[r->node].SL : nodes[r->node].SL;
+}
+
+// Sends the request an entry describes, first time or again
+static void request_send(_xbee_request *r)
+{
+	uint32_t SL, SH;
+	uint8_t pin_state;
+
+	SL = request_SL(r);
+	SH = r->policy == REQ_INIT ? temp_nodes[r->node].SH : nodes[r->node].SH;
+
+	switch ( r->cmd )  {
+		case PROBE2_ONorOFF:
+			pin_state = r->cont == kWSN_StatProbesOn ? PIN_HIGH : PIN_LOW;
+			xbee_set_DIO(SL, SH, PROBE1_PIN, pin_state, NO_ACK);
+			r->frame_ID = xbee_set_DIO(SL, SH, PROBE2_PIN, pin_state, ACK);
+		break;
+		case DIO_sample:
+			r->frame_ID = xbee_sample_DIO(SL, SH);
+		break;
+		case CHANGES_APPLIED:
+			r->frame_ID = xbee_apply_changes(SL, SH);
+		break;
+		default:
+			r->frame_ID = wireless_start_network_sleep(SL, SH);
+	}
+	r->sent = (uint16_t)clock_ms();
+	r->resend = false;
+	if ( r->policy == REQ_INIT )
+		temp_nodes[r->node].frame_ID = r->frame_ID;
+}
+
+static void request_give_up(_xbee_request *r)
+{
+	r->frame_ID = 0;
+	if ( r->policy == REQ_INIT )  {
+		temp_nodes[r->node].frame_ID = 0;
+		temp_nodes[r->node].init_status = NODE_FAILED;
+	}
+}
+
+static void request_add(uint8_t node, uint16_t cmd, uint8_t cont, uint8_t policy)
+{
+	_xbee_request *r, *slot = &xbee_requests[0];
+	uint16_t now = (uint16_t)clock_ms();
+
+	for ( r = xbee_requests; r < &xbee_requests[REQ_SLOTS]; r++ )  {
+		if ( !r->frame_ID )  {
+			slot = r;
+			break;
+		}
+		if ( (uint16_t)(now - r->sent) > (uint16_t)(now - slot->sent) )
+			slot = r;
+	}
+	if ( slot->frame_ID )
+		request_give_up(slot);
+	slot->node = node;
+	slot->cmd = cmd;
+	slot->cont = cont;
+	slot->policy = policy;
+	slot->tries = 0;
+	request_send(slot);
+}
+
+// Entry waiting on this frame ID, or NULL
+static _xbee_request *request_find(uint8_t frame_ID)
+{
+	_xbee_request *r;
+
+	if ( !frame_ID )
+		return NULL;
+	for ( r = xbee_requests; r < &xbee_requests[REQ_SLOTS]; r++ )
+		if ( r->frame_ID == frame_ID )
+			return r;
+	return NULL;
+}
+
+// A request resent keeps its entry, so a late answer to the first send is
+//  still taken while the resend waits out its backoff
+void wireless_retry_requests(uint16_t budget)
+{
+	static uint16_t last;
+	_xbee_request *r;
+	uint16_t now = (uint16_t)clock_ms(), wait;
+
+	if ( now == last )
+		return;
+	last = now;
+
+	for ( r = xbee_requests; r < &xbee_requests[REQ_SLOTS]; r++ )  {
+		if ( !r->frame_ID )
+			continue;
+		if ( r->resend )  {
+			if ( (int16_t)(now - r->due) < 0 || UART1_tx_free() < 2 * WIRELESS_FRAME_MAX )
+				continue;
+			// the settings AC applies may have been lost with it: they
+			//  go out again first, a setting a pass
+			if ( r->cmd == CHANGES_APPLIED && wireless_initialize_IO(r->node) )
+				continue;
+			// RETRY_INIT applies to each initialization step, by its entry's count
+			r->tries++;
+			if ( r->policy != REQ_INIT )
+				nodes[r->node].retries++;
+			request_send(r);
+			continue;
+		}
+		if ( (uint16_t)(now - r->sent) < UART_TIMEOUT )
+			continue;
+		wait = retry_backoff[r->policy] << r->tries;
+		wait += jitter(wait);
+		if ( r->tries < retry_limit[r->policy] && (uint32_t)wait + UART_TIMEOUT <= budget )  {
+			r->resend = true;
+			r->due = now + wait;
+			if ( r->cmd == CHANGES_APPLIED )
+				temp_nodes[r->node].io_param = 0;
+		}
+		else
+			request_give_up(r);
+	}
+}
+
+uint8_t wireless_requests_pending(void)
+{
+	_xbee_request *r;
+	uint8_t n = 0;
+
+	for ( r = xbee_requests; r < &xbee_requests[REQ_SLOTS]; r++ )
+		if ( r->frame_ID )
+			n++;
+	return n;
+}
+
 void wireless_init_sleep()
 {
 	xbee_set_sleep_time( SETUP_SLEEP_TIME );
-	xbee_set_wake_time( SETUP_WAKE_TIME );
+	xbee_set_wake_time( SETUP_WAKE_TIME, ACK );
 
 	// Because node sampling is initiated by receipt of a "network woke up" message, turn these messages off during setup
 	xbee_set_sleep_coord( NO_SLEEP_MESSAGES );
@@ -71,60 +229,112 @@ void wireless_sample_battery(uint8_t node_number)
 	char lcd_string[10];
 
 	uint16_t battery = xbee_sample_batt(nodes[node_number].SL,nodes[node_number].SH);
-	uint8_t volts_1 = battery/1000;
-
-	// print battery voltage to screen
-	itoa(volts_1, lcd_string, 10);
-	dogm_puts(lcd_string);
-	dogm_puts(".");
-	uint16_t volts_tenths = battery%1000;
-	itoa(volts_tenths, lcd_string, 10);
-	dogm_puts(lcd_string);
-	dogm_puts("V");
+
+	// print battery voltage to screen, battery is in mV
+	format_fixed(lcd_string, battery, 3, 0);
+	display_puts(lcd_string);
+	display_puts("V");
 }
 
+// The acknowledgement of D9 is the same for on and off; the request table
+//  says which one it answers
 void wireless_turn_on_probes(uint8_t node_number)
 {
-	probes_on = true;
-	frameID = xbee_set_DIO(nodes[node_number].SL,nodes[node_number].SH, PROBE1_PIN, PIN_HIGH, NO_ACK); //This frameID is invalid - there will be no ack - but have to get some return from function
-	frameID = xbee_set_DIO(nodes[node_number].SL,nodes[node_number].SH, PROBE2_PIN, PIN_HIGH, ACK);
+	energy_set( ENERGY_PROBES, true );
+	request_add( node_number, PROBE2_ONorOFF, kWSN_StatProbesOn, REQ_PROBES );
 }
 
 void wireless_turn_off_probes(uint8_t node_number)
 {
-	probes_on = false;
-	frameID = xbee_set_DIO(nodes[node_number].SL,nodes[node_number].SH, PROBE1_PIN, PIN_LOW, NO_ACK);
-	frameID = xbee_set_DIO(nodes[node_number].SL,nodes[node_number].SH, PROBE2_PIN, PIN_LOW, ACK);
+	energy_set( ENERGY_PROBES, false );
+	request_add( node_number, PROBE2_ONorOFF, kWSN_StatProbesOff, REQ_PROBES );
 }
 
-void wireless_initialize_IO(uint32_t SL, uint32_t SH)
+// Pipelined sampling: no acknowledgement, the shared warmup starts after the last node
+void wireless_set_probes(uint8_t node_number, bool on)
 {
-	xbee_set_DIO(SL, SH, PROBE_1_INPUT_PIN, ANALOG_INPUT, ACK);
-	xbee_set_DIO(SL, SH, PROBE_2_INPUT_PIN, ANALOG_INPUT, ACK);
-	xbee_set_DIO(SL, SH, DIP_PIN1, DIGITAL_INPUT, ACK);
-	xbee_set_DIO(SL, SH, DIP_PIN2, DIGITAL_INPUT, ACK);
-	xbee_set_DIO(SL, SH, DIP_PIN4, DIGITAL_INPUT, ACK);
-	xbee_set_DIO(SL, SH, DIP_PIN8, DIGITAL_INPUT, ACK);
-	xbee_set_pullups(SL, SH, PULLUP_BITS);
-	// add command to write these settings to non-volatile memory
+	uint8_t pin_state = on ? PIN_HIGH : PIN_LOW;
+
+	energy_set( ENERGY_PROBES, on );
+	xbee_set_DIO(nodes[node_number].SL,nodes[node_number].SH, PROBE1_PIN, pin_state, NO_ACK);
+	xbee_set_DIO(nodes[node_number].SL,nodes[node_number].SH, PROBE2_PIN, pin_state, NO_ACK);
+}
+
+// The settings are queued on the node and applied together by AC, so
+//  initialization costs one acknowledged round trip per node instead of seven.
+//  They go out one per call, as the whole batch (160 bytes, more with push
+//  sampling) would not fit the transmit queue. DH and DL, at two frames, are
+//  the largest. Returns false once every setting has been sent.
+// Only AC is acknowledged, and its ack does not show the queued settings
+//  arrived, so a lost one does not fail this step. It only shows in the IS
+//  samples: a lost analog pin makes them short, a packet error (at the
+//  address read, the node fails), and a lost DIP pin or PR misreads the
+//  address.
+bool wireless_initialize_IO(uint8_t temp_node)
+{
+	_temp_node *t = &temp_nodes[temp_node];
+	uint32_t SL = t->SL, SH = t->SH;
+
+	if ( t->io_param >= (SAMPLING_PUSH ? IO_SETTINGS_PUSH : IO_SETTINGS) )
+		return false;
+
+	xbee_queue_parameters(true);
+	switch ( t->io_param++ )  {
+		case 0: xbee_set_DIO(SL, SH, PROBE_1_INPUT_PIN, ANALOG_INPUT, ACK); break;
+		case 1: xbee_set_DIO(SL, SH, PROBE_2_INPUT_PIN, ANALOG_INPUT, ACK); break;
+		case 2: xbee_set_DIO(SL, SH, DIP_PIN1, DIGITAL_INPUT, ACK); break;
+		case 3: xbee_set_DIO(SL, SH, DIP_PIN2, DIGITAL_INPUT, ACK); break;
+		case 4: xbee_set_DIO(SL, SH, DIP_PIN4, DIGITAL_INPUT, ACK); break;
+		case 5: xbee_set_DIO(SL, SH, DIP_PIN8, DIGITAL_INPUT, ACK); break;
+		case 6: xbee_set_pullups(SL, SH, PULLUP_BITS); break;
+		case 7: xbee_set_destination(SL, SH, bridge_SL, bridge_SH); break;
+		default: xbee_set_sample_rate(SL, SH, SAMPLE_PUSH_INTERVAL);
+	}
+	xbee_queue_parameters(false);
+	return true;
 }
 
-void wireless_sample_DIO(uint32_t SL, uint32_t SH)
+void wireless_sample_DIO(uint8_t node_number)
 {
-	frameID = xbee_sample_DIO( SL, SH );
+	request_add( node_number, DIO_sample, kWSN_StatSampleReady, REQ_SAMPLE );
+}
+
+// Sends a discovered node its next initialization step. The request's
+//  continuation is the step after it.
+void wireless_init_step(uint8_t temp_node)
+{
+	switch ( temp_nodes[temp_node].init_status )  {
+		case IO_UNINITIALIZED:
+			// AC, to apply the queued settings, once they are all out
+			if ( !wireless_initialize_IO(temp_node) )
+				request_add( temp_node, CHANGES_APPLIED, ADDR_UNINITIALIZED, REQ_INIT );
+		break;
+		case ADDR_UNINITIALIZED:
+			request_add( temp_node, DIO_sample, ADDR_INITIALIZED, REQ_INIT );
+		break;
+		default:
+			request_add( temp_node, WIRELESS_SLEEP_STARTED, NODE_READY, REQ_INIT );
+	}
 }
 
 void wireless_start_sleep()
 {
 	xbee_start_sleep_coord();
 	xbee_set_sleep_time( SLEEP_TIME );
-	xbee_set_wake_time( WAKE_TIME );
+	xbee_set_wake_time( wake_time, ACK );
 	xbee_set_sleep_coord( SEND_SLEEP_MESSAGES );
 }
 
-void wireless_start_network_sleep(uint32_t SL, uint32_t SH)
+// New wake time from wake.c, taken up by the network at its next sync. No
+//  response is asked for, as it would land in the middle of sampling.
+void wireless_set_wake_time(uint16_t ms)
 {
-	xbee_start_network_sleep( SL, SH );
+	xbee_set_wake_time( ms, NO_ACK );
+}
+
+uint8_t wireless_start_network_sleep(uint32_t SL, uint32_t SH)
+{
+	return xbee_start_network_sleep( SL, SH );
 }
 
 void wireless_node_discover()
@@ -132,17 +342,58 @@ void wireless_node_discover()
 	xbee_node_discover();
 }
 
-uint8_t wireless_parse_message( bool init_state )  {
+void wireless_read_address()
+{
+	xbee_read_address();
+}
 
-	uint8_t network_status, frameID, res, delimiter, len, frame_type, add, tmp, return_state, DIO;
-	uint16_t cmd, ADC1, ADC2;
-	uint32_t add_H, add_L;
+// A step of node initialization answered. The request entry says which
+//  node it advances and to what.
+static void init_response( const _xbee_frame *frame, const _xbee_request *req )
+{
+	_temp_node *t = &temp_nodes[req->node];
+	uint8_t ID;
 	char lcd_string[5];
 
-	delimiter = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-	len = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-	len = BUFF_GetBuffByte(BUFF_REMOVE_DATA);			// overwrite first length byte, it will be zero
-	frame_type = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
+	t->frame_ID = 0;
+	t->init_status = req->cont;
+
+	switch ( req->cmd )  {
+		case DIO_sample:					// DIP setting, which is the SDI-12 address
+			if ( frame->len < RX_LEN_IS )  {
+				t->init_status = NODE_FAILED;
+				break;
+			}
+			ID = DIP_to_ID( frame->data[RX_OFS_IS_DIO] );
+			t->ID = ID;
+			nodes[ID].DIP_setting = ID;
+
+			// print to LCD
+			if ( !HEADLESS )  {
+				display_gotoxy(10,1);
+				format_fixed(lcd_string, ID, 0, 0);
+				display_puts(lcd_string);
+			}
+
+			// Array index of nodes[] is the SDI-12 address, set by DIP switch
+			nodes[ID].SL = t->SL;
+			nodes[ID].SH = t->SH;
+		break;
+
+		case WIRELESS_SLEEP_STARTED:
+			node_ids[number_of_nodes++] = t->ID;
+		break;
+	}
+}
+
+static uint8_t parse_frame( const _xbee_frame *frame, bool init_state )  {
+
+	uint8_t network_status, len, frame_type, return_state;
+	uint16_t cmd;
+	_xbee_request *r, req;
+
+	len = frame->len;
+	frame_type = frame->data[RX_OFS_TYPE];
 
 	switch ( frame_type )  {
 
@@ -150,135 +401,107 @@ uint8_t wireless_parse_message( bool init_state )  {
 		// 11/10/2010: Only time it's a valid response is during node discovery
 		case AT_COMMAND_RESPONSE:
 
-			frameID = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-			cmd	 = ( BUFF_GetBuffByte(BUFF_REMOVE_DATA) << 8 )
-				 | ( BUFF_GetBuffByte(BUFF_REMOVE_DATA));
+			if ( len < RX_LEN_AT )
+				return kWSN_StatPacketError;
+			cmd = RX_U16(frame, RX_OFS_AT_CMD);
 
 			// packets received in response to node discovery
-			if ( cmd == ND_RESPONSE && BUFF_GetBuffByte(BUFF_REMOVE_DATA) == 0x00)  {
-
-				// remove reserved bytes from buffer
-				res = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-				res = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-
-				add_H  = ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) << 24 );
-				add_H |= ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) << 16 );
-				add_H |= ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) << 8  );
-				add_H |= ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) );
-				add_L  = ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) << 24 );
-				add_L |= ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) << 16 );
-				add_L |= ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) << 8  );
-				add_L |= ( (uint32_t)(BUFF_GetBuffByte(BUFF_REMOVE_DATA)) );
-
-				temp_nodes[number_of_nd_nodes].SH = add_H;
-				temp_nodes[number_of_nd_nodes].SL = add_L;
+			if ( cmd == ND_RESPONSE && frame->data[RX_OFS_AT_STATUS] == 0x00 && len >= RX_LEN_ND )  {
+
+				if ( number_of_nd_nodes >= NODE_ARRAY_SIZE )
+					return kWSN_StatFrameDropped;
+				temp_nodes[number_of_nd_nodes].SH = RX_U32(frame, RX_OFS_ND_SH);
+				temp_nodes[number_of_nd_nodes].SL = RX_U32(frame, RX_OFS_ND_SL);
+				temp_nodes[number_of_nd_nodes].init_status = IO_UNINITIALIZED;
+				temp_nodes[number_of_nd_nodes].io_param = 0;
 				number_of_nd_nodes++;
-				dogm_putc(number_of_nd_nodes+48);
-				return_state = kWSN_StatNodeDiscovery;
+				display_putc(number_of_nd_nodes+48);
+				return_state = kWSN_StatFrameDropped;
+			}
+			// own serial number, requested before node discovery
+			else if ( (cmd == SERIAL_HIGH || cmd == SERIAL_LOW) && frame->data[RX_OFS_AT_STATUS] == 0x00 && len >= RX_LEN_AT_U32 )  {
+				if ( cmd == SERIAL_HIGH )
+					bridge_SH = RX_U32(frame, RX_OFS_AT_DATA);
+				else
+					bridge_SL = RX_U32(frame, RX_OFS_AT_DATA);
+				return_state = kWSN_StatFrameDropped;
 			}
 			else		// other local packets?
 				return_state = kWSN_StatDoneSampling;
 		break;
 
-		//These occur during intialization, when a DIO sample is received.
+		// Answers to requests in the table; dispatched on the request entry
 		case REMOTE_AT_COMMAND_RESPONSE:
 
-			frameID = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
+			if ( len < RX_LEN_REMOTE )
+				return init_state ? kWSN_StatPacketError : UNINITIALIZED;
+
+			cmd = RX_U16(frame, RX_OFS_REMOTE_CMD);
+
+			// nothing waiting on it: a duplicate, or the request was given up
+			r = request_find( frame->data[RX_OFS_FRAME_ID] );
+			if ( !r || r->cmd != cmd || request_SL(r) != RX_U32(frame, RX_OFS_REMOTE_SL) )
+				return kWSN_StatFrameDropped;
 
-			// Next bytes are the address of the originating node.
-			for ( add = 0; add < 8; add++ )  {
-				tmp = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
+			// not delivered or refused: resent like a timeout
+			if ( frame->data[RX_OFS_REMOTE_STATUS] != SUCCESSFUL_CMD )  {
+				if ( r->policy != REQ_INIT )
+					nodes[r->node].Packet_errors++;
+				if ( !r->resend )
+					r->sent = (uint16_t)clock_ms() - UART_TIMEOUT;
+				return kWSN_StatFrameDropped;
 			}
+			req = *r;
+			r->frame_ID = 0;
 
-			res = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-			res = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-			cmd	 = ( BUFF_GetBuffByte(BUFF_REMOVE_DATA) << 8 )
-				 | ( BUFF_GetBuffByte(BUFF_REMOVE_DATA));
-
-			if ( BUFF_GetBuffByte(BUFF_REMOVE_DATA) == SUCCESSFUL_CMD )  {
-
-				switch ( cmd )  {
-
-					//Possible DIO samples:
-					//  -if unitialized, it's DIP setting, otherwise it's
-					//  -sensor data
-					case DIO_sample:
-
-						// clear next five bytes
-						for ( add = 0; add < 5; add++ )  {
-							tmp = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-						}
-
-						DIO 	=  BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-						ADC1 	= (BUFF_GetBuffByte(BUFF_REMOVE_DATA) << 8) + BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-						ADC2	= (BUFF_GetBuffByte(BUFF_REMOVE_DATA) << 8) + BUFF_GetBuffByte(BUFF_REMOVE_DATA);
-
-						uint8_t ID = DIP_to_ID(DIO);
-
-						if ( !init_state )  {		//message is a response with DIP settings
-							nodes[ID].DIP_setting = ID;
-							node_ids[number_of_nodes] = ID;
-
-							// print to LCD
-							dogm_gotoxy(10,1);
-							itoa(ID,lcd_string,10);
-							dogm_puts(lcd_string);
-							_delay_ms(500);
-
-							// take addresses from temporary array and put in nodes array. Array index is the SDI-12 address, set by DIP switch
-							nodes[ID].SL = temp_nodes[number_of_nodes].SL;
-							nodes[ID].SH = temp_nodes[number_of_nodes].SH;
-							return_state = UNINITIALIZED;
-							init_status = ADDR_INITIALIZED;
-						}
-
-						else {						//message has sensor data
-							ADC_sample.ADC1 = ADC1;
-							ADC_sample.ADC2 = ADC2;
-							ADC_sample.node = ID;
-							return_state = kWSN_StatSampleReady;
-						}
-					break;
-
-					case WIRELESS_SLEEP_STARTED:
-						return_state = UNINITIALIZED;
-						init_status = IO_UNINITIALIZED;
-						number_of_nodes++;
-					break;
-
-					case PROBE1_ONorOFF:
-						return_state = kWSN_StatWaitingForMessage;
-					break;
-
-					case PROBE2_ONorOFF:				// same incoming packet for both, have to keep track of which command was sent
-						if ( probes_on ) 				// if the last command was to turn on the probes on, sample them
-							return_state = kWSN_StatProbesOn;
-						else  							// last command turned probes off
-							return_state = kWSN_StatProbesOff;
-					break;
-
-					case PULLUPS_SET:
-						return_state = UNINITIALIZED;
-						init_status = ADDR_UNINITIALIZED;
-					break;
-
-					default:
-						return_state = kWSN_StatPacketError;
-				}
+			if ( !init_state )  {
+				init_response( frame, &req );
+				return UNINITIALIZED;
 			}
-			else {										//bad response
-				//log error
-				return_state = kWSN_StatPacketError;
+
+			if ( cmd == DIO_sample )  {			// sensor data
+				if ( len < RX_LEN_IS )
+					return kWSN_StatPacketError;
+				// a node restored from EEPROM is confirmed by its DIP setting
+				if ( nodes[req.node].restored )  {
+					if ( DIP_to_ID( frame->data[RX_OFS_IS_DIO] ) != req.node )
+						return kWSN_StatPacketError;
+					nodes[req.node].restored = false;
+				}
+				ADC_sample.ADC1 = RX_U16(frame, RX_OFS_IS_ADC1);
+				ADC_sample.ADC2 = RX_U16(frame, RX_OFS_IS_ADC2);
+				ADC_sample.node = req.node;
 			}
-			if ( !init_state )  {
-				return_state = UNINITIALIZED;
+			return_state = req.cont;
+		break;
+
+		// Sample pushed by a node set up for push sampling, filed by source address
+		case IO_SAMPLE_RX:
+
+			// before initialization (or rediscovery) has finished: ignored
+			if ( !init_state )
+				return kWSN_StatFrameDropped;
+			if ( len < RX_LEN_PUSH )
+				return kWSN_StatPacketError;
+			ADC_sample.node = node_find( RX_U32(frame, RX_OFS_PUSH_SL), RX_U32(frame, RX_OFS_PUSH_SH) );
+			if ( ADC_sample.node == NODE_NOT_FOUND )
+				return kWSN_StatPacketError;
+			if ( nodes[ADC_sample.node].restored )  {
+				if ( DIP_to_ID( frame->data[RX_OFS_PUSH_DIO] ) != ADC_sample.node )
+					return kWSN_StatPacketError;
+				nodes[ADC_sample.node].restored = false;
 			}
+			ADC_sample.ADC1 = RX_U16(frame, RX_OFS_PUSH_ADC1);
+			ADC_sample.ADC2 = RX_U16(frame, RX_OFS_PUSH_ADC2);
+			return_state = kWSN_StatSampleReady;
 		break;
 
 		//Occur when network wakes up or sleeps
 		case MODEM_STATUS:
 
-			network_status = BUFF_GetBuffByte(BUFF_REMOVE_DATA);
+			if ( len < RX_LEN_MODEM_STATUS )
+				return init_state ? kWSN_StatPacketError : UNINITIALIZED;
+			network_status = frame->data[RX_OFS_MODEM_STATUS];
 
 			if ( network_status == NETWORK_WOKE_UP )  {
 					return_state = kWSN_StatBeforeSampling;
@@ -289,8 +512,9 @@ uint8_t wireless_parse_message( bool init_state )  {
 			else
 				return_state = kWSN_StatPacketError;
 
+			// network cycling while discovery or initialization runs
 			if ( !init_state )  {
-				return_state = UNINITIALIZED;
+				return_state = kWSN_StatFrameDropped;
 			}
 
 		break;
@@ -301,3 +525,16 @@ uint8_t wireless_parse_message( bool init_state )  {
 
 	return return_state;
 }
+
+bool wireless_message_waiting()
+{
+	return xbee_rx_tail != xbee_rx_head;
+}
+
+uint8_t wireless_parse_message( bool init_state )
+{
+	uint8_t next_state = parse_frame( &xbee_rx_frames[xbee_rx_tail], init_state );
+
+	xbee_rx_tail = RX_NEXT_SLOT(xbee_rx_tail);		// slot free for the ISR
+	return next_state;
+}
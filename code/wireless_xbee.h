@@ -15,16 +15,20 @@
 //XBee-specific 
 #define PROBE1_ONorOFF				0x4438
 #define PROBE2_ONorOFF				0x4439
-#define PULLUPS_SET					0x5052
+#define CHANGES_APPLIED				0x4143
 #define API_start_delimiter 		0x7E
 #define ANALOG_INPUT 				0x02
 #define DIGITAL_INPUT				0x03
+#define WIRELESS_FRAME_MAX			23						// largest frame sent: remote AT with 4 parameter bytes
+#define IO_SETTINGS					7						// queued ahead of AC: D pins and PR
+#define IO_SETTINGS_PUSH			9						// and DH/DL, IR for push sampling
 
-//State definitions for initialization routine
+//State definitions for initialization routine, kept per node in temp_nodes[]
 #define IO_UNINITIALIZED 	 		0x01
 #define ADDR_UNINITIALIZED 			0x02
 #define ADDR_INITIALIZED			0x03
-#define INIT_WAITING 				0x04
+#define NODE_READY					0x04
+#define NODE_FAILED					0x05
 
 //Pin settings specific to SDI-12 node unit PCB:
 #define PROBE1_PIN					'8'
@@ -37,22 +41,152 @@
 #define DIP_PIN8					'6'
 #define PULLUP_BITS 				0x2029 					// 2029: Pullups on DIO 1,4,7,6
 
+//Received frames. The USART1 receive ISR stores the frame data (API
+// identifier to checksum) contiguously, so fields are read at fixed offsets.
+// Complete frames are queued in RX_FRAME_SLOTS slots, one of which is always
+// the one being received, and the main loop parses them in order.
+#define RX_FRAME_MAX				64
+#ifndef RX_FRAME_SLOTS
+#define RX_FRAME_SLOTS				4
+#endif
+#define RX_NEXT_SLOT(slot)			( (slot) + 1 == RX_FRAME_SLOTS ? 0 : (slot) + 1 )
+#define RX_GAP_MS					2						// pause that ends a frame early: a byte takes ~1 ms
+
+#define RX_OFS_TYPE					0
+#define RX_OFS_FRAME_ID				1
+#define RX_OFS_MODEM_STATUS			1						// modem status (0x8A)
+#define RX_OFS_AT_CMD				2						// AT command response (0x88)
+#define RX_OFS_AT_STATUS			4
+#define RX_OFS_ND_SH				7						// ND data: MY, SH, SL, ...
+#define RX_OFS_ND_SL				11
+#define RX_OFS_REMOTE_SH			2						// remote AT command response (0x97)
+#define RX_OFS_REMOTE_SL			6
+#define RX_OFS_REMOTE_CMD			12
+#define RX_OFS_REMOTE_STATUS		14
+#define RX_OFS_IS_DIO				20						// IS data: sets, DIO mask, ADC mask, DIO, ADCs
+#define RX_OFS_IS_ADC1				21
+#define RX_OFS_IS_ADC2				23
+#define RX_OFS_AT_DATA				5						// AT command response value
+#define RX_OFS_PUSH_SH				1						// IO data sample (0x92): source, options, sample set
+#define RX_OFS_PUSH_SL				5
+#define RX_OFS_PUSH_DIO				17
+#define RX_OFS_PUSH_ADC1			18
+#define RX_OFS_PUSH_ADC2			20
+
+#define RX_LEN_MODEM_STATUS			2						// frame data needed to reach the last field used
+#define RX_LEN_AT					5
+#define RX_LEN_ND					15
+#define RX_LEN_REMOTE				15
+#define RX_LEN_IS					25
+#define RX_LEN_AT_U32				9
+#define RX_LEN_PUSH					22
+
+//Big-endian fields of a received frame
+#define RX_U16(f, ofs)	( ((uint16_t)(f)->data[ofs] << 8) | (f)->data[(ofs) + 1] )
+#define RX_U32(f, ofs)	( ((uint32_t)RX_U16(f, ofs) << 16) | RX_U16(f, (ofs) + 2) )
+
+typedef struct
+{
+	uint8_t		len;										// frame data bytes, without the checksum
+	uint8_t		data[RX_FRAME_MAX];
+} _xbee_frame;
+
+extern _xbee_frame xbee_rx_frames[RX_FRAME_SLOTS];
+extern volatile uint8_t xbee_rx_head;						// slot being received, written by the ISR
+extern volatile uint8_t xbee_rx_tail;						// oldest complete frame, written by the parser
+extern uint16_t xbee_rx_overflows;							// complete frames dropped with every slot full
+extern volatile uint16_t xbee_rx_aborts;					// frames given up: bad length, receive error or pause
+
+extern uint32_t bridge_SH, bridge_SL;						// local XBee, destination of pushed samples
+
+// Requests sent with a frame ID and not yet answered. A 0x97 response is
+//  dispatched on the entry with its frame ID, which is then freed; responses
+//  with no entry (duplicates, answers to given up requests) are dropped.
+//  A request unanswered for UART_TIMEOUT, or answered with a failed status
+//  (not delivered), is resent by the retry policy of its class, or given up.
+#ifndef REQ_SLOTS
+#define REQ_SLOTS					16						// the oldest entry is reused when all are taken
+#endif
+
+#define REQ_PROBES					0						// request classes, each with a retry policy
+#define REQ_SAMPLE					1
+#define REQ_INIT					2
+
+// Retry policies: resends after a timeout, and the wait before the first
+//  resend in msec, doubled for each one after it. A random part of
+//  up to the wait again is added, so nodes that lost the same burst are not
+//  resent to in step. No resend is made that could not be answered within
+//  the budget given to wireless_retry_requests.
+#ifndef RETRY_PROBES
+#define RETRY_PROBES				2
+#endif
+#define RETRY_PROBES_BACKOFF		50
+#ifndef RETRY_SAMPLE
+#define RETRY_SAMPLE				2
+#endif
+#define RETRY_SAMPLE_BACKOFF		50
+#ifndef RETRY_INIT
+#define RETRY_INIT					2						// a node still failing is given up
+#endif
+#define RETRY_INIT_BACKOFF			100
+
+typedef struct
+{
+	uint8_t		frame_ID;									// 0: slot free
+	uint8_t		node;										// SDI-12 address, or temp_nodes[] index while initializing
+	uint16_t	cmd;										// AT command sent
+	uint8_t		cont;										// state to continue in when answered
+	uint8_t		policy;										// REQ_ class
+	uint8_t		tries;										// resends so far
+	bool		resend;										// timed out, resent at due
+	uint16_t	sent;										// clock_ms() when sent, low 16 bits
+	uint16_t	due;
+} _xbee_request;
+
+extern _xbee_request xbee_requests[REQ_SLOTS];
+
 void wireless_turn_on_probes(uint8_t node_number);
 
 void wireless_turn_off_probes(uint8_t node_number);
 
-void wireless_initialize_IO(uint32_t SL, uint32_t SH);
+void wireless_set_probes(uint8_t node_number, bool on);
+
+bool wireless_initialize_IO(uint8_t temp_node);
 
-void wireless_sample_DIO(uint32_t SL, uint32_t SH);
+void wireless_sample_DIO(uint8_t node_number);
+
+void wireless_init_step(uint8_t temp_node);
+
+/*
+ * Description: Resend or give up requests that have timed out, by the retry
+ *				policy of their class. Runs at most once per millisecond.
+ *				Given up initialization steps fail their node.
+ * Input: ticks left in which a resend must be answered
+ * Output: none
+ */
+void wireless_retry_requests(uint16_t budget);
+
+/*
+ * Description: Requests sent or waiting to be resent.
+ * Input: none
+ * Output: number of requests
+ */
+uint8_t wireless_requests_pending(void);
 
 void wireless_start_sleep();
 
+void wireless_set_wake_time(uint16_t ms);
+
+bool wireless_message_waiting();
+
 uint8_t wireless_parse_message(bool initialized);
 
-void wireless_start_network_sleep(uint32_t SL, uint32_t SH);
+uint8_t wireless_start_network_sleep(uint32_t SL, uint32_t SH);
 
 void wireless_node_discover();
 
+void wireless_read_address();
+
 void wireless_sample_battery(uint8_t node_number);
 
 #endif
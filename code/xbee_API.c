@@ -16,7 +16,6 @@
 #include <stdio.h>
 #include "xbee_API.h"
 #include "uart.h"
-#include "RingBuff.h"
 #include "nodes.h"
 #include "main.h"
 
@@ -35,6 +34,8 @@ typedef struct
 
 volatile _API API_pkt;
 
+static bool queue_parameters;
+
 /*
  * Initialization functions
  */
@@ -43,7 +44,43 @@ void xbee_node_discover()
 {
 	API_pkt.AT_cmd[0] = 'N';
   	API_pkt.AT_cmd[1] = 'D';
-	local_AT_command_request(4);
+	local_AT_command_request(4, ACK);
+}
+
+// Serial number of the local XBee, answered with AT command responses
+void xbee_read_address()
+{
+	API_pkt.AT_cmd[0] = 'S';
+	API_pkt.AT_cmd[1] = 'H';
+	local_AT_command_request(4, ACK);
+	API_pkt.AT_cmd[0] = 'S';
+	API_pkt.AT_cmd[1] = 'L';
+	local_AT_command_request(4, ACK);
+}
+
+void xbee_set_destination(uint32_t SL, uint32_t SH, uint32_t DL, uint32_t DH)
+{
+	uint8_t i;
+
+	API_pkt.AT_cmd[0] = 'D';
+	API_pkt.AT_cmd[1] = 'H';
+	for ( i = 0; i < 4; i++ )
+		API_pkt.AT_cmd_value[i] = DH >> (24 - 8 * i);
+	remote_AT_command_request( SL, SH, 0x13, ACK );
+	API_pkt.AT_cmd[0] = 'D';
+	API_pkt.AT_cmd[1] = 'L';
+	for ( i = 0; i < 4; i++ )
+		API_pkt.AT_cmd_value[i] = DL >> (24 - 8 * i);
+	remote_AT_command_request( SL, SH, 0x13, ACK );
+}
+
+void xbee_set_sample_rate(uint32_t SL, uint32_t SH, uint16_t rate_ms)
+{
+	API_pkt.AT_cmd[0] = 'I';
+	API_pkt.AT_cmd[1] = 'R';
+	API_pkt.AT_cmd_value[0] = rate_ms >> 8;
+	API_pkt.AT_cmd_value[1] = (uint8_t)rate_ms;
+	remote_AT_command_request( SL, SH, 0x11, ACK );
 }
 
 void xbee_set_pullups(uint32_t SL, uint32_t SH, uint16_t pullups)
@@ -57,12 +94,27 @@ void xbee_set_pullups(uint32_t SL, uint32_t SH, uint16_t pullups)
 	remote_AT_command_request( SL, SH, 0x11, ACK );
 }
 
-void xbee_start_network_sleep(uint32_t SL, uint32_t SH)
+void xbee_queue_parameters(bool queue)
+{
+	queue_parameters = queue;
+}
+
+uint8_t xbee_apply_changes(uint32_t SL, uint32_t SH)
+{
+	queue_parameters = false;
+	API_pkt.AT_cmd[0] = 'A';
+	API_pkt.AT_cmd[1] = 'C';
+	remote_AT_command_request( SL, SH, 0x0F, ACK );
+	return API_pkt.Frame_ID;
+}
+
+uint8_t xbee_start_network_sleep(uint32_t SL, uint32_t SH)
 {
 	API_pkt.AT_cmd[0] = 'S';
 	API_pkt.AT_cmd[1] = 'M';
 	API_pkt.AT_cmd_value[0] = 8;
 	remote_AT_command_request( SL, SH, 0x10, ACK);
+	return API_pkt.Frame_ID;
 }
 
 void xbee_start_sleep_coord()
@@ -70,7 +122,7 @@ void xbee_start_sleep_coord()
 	API_pkt.AT_cmd[0] = 'S';
 	API_pkt.AT_cmd[1] = 'M';
 	API_pkt.AT_cmd_value[0] = 7;
-	local_AT_command_request(5);
+	local_AT_command_request(5, ACK);
 }
 
 void xbee_set_sleep_coord(bool send_status_messages)
@@ -82,7 +134,7 @@ void xbee_set_sleep_coord(bool send_status_messages)
 	else
 		API_pkt.AT_cmd_value[0] = 1;
 
-	local_AT_command_request(5);
+	local_AT_command_request(5, ACK);
 }
 
 void xbee_set_sleep_time(uint16_t sleep_time)
@@ -91,16 +143,16 @@ void xbee_set_sleep_time(uint16_t sleep_time)
 	API_pkt.AT_cmd[1] = 'P';
 	API_pkt.AT_cmd_value[0] = sleep_time >> 8;
   	API_pkt.AT_cmd_value[1] = (uint8_t)sleep_time;
-	local_AT_command_request(6);
+	local_AT_command_request(6, ACK);
 }
 
-void xbee_set_wake_time(uint16_t wake_time)
+void xbee_set_wake_time(uint16_t wake_time, bool ack)
 {
 	API_pkt.AT_cmd[0] = 'S';
 	API_pkt.AT_cmd[1] = 'T';
 	API_pkt.AT_cmd_value[0] = wake_time >> 8;
   	API_pkt.AT_cmd_value[1] = (uint8_t)wake_time;
-	local_AT_command_request(6);
+	local_AT_command_request(6, ack);
 }
 
 /*
@@ -166,7 +218,16 @@ static void increment_pkt()
 
 static void remote_AT_command_request(uint32_t SL, uint32_t SH, uint8_t packet_length, bool ack)
 {
-  	uint8_t i, checksum, pkt_identifier, pkt_ID;
+  	uint8_t i, checksum, pkt_identifier, pkt_ID, options;
+
+	// queued writes go out with frame ID 0 and so are never answered; the
+	//  AC that applies them is acknowledged, but that only shows AC arrived
+	if ( queue_parameters && packet_length > 15 )  {
+		options = REMOTE_OPT_QUEUE;
+		ack = NO_ACK;
+	}
+	else
+		options = REMOTE_OPT_APPLY;
 
   	if ( ack ) {
 		increment_pkt();
@@ -176,6 +237,7 @@ static void remote_AT_command_request(uint32_t SL, uint32_t SH, uint8_t packet_l
 		pkt_ID = 0;									// No response expected
 
 	pkt_identifier = 0x17;
+	UART1_tx_wait(packet_length + 4);				// delimiter, length and checksum
 	UART1_Transmit(API_start_delimiter);    		// Start delimiter
 	UART1_Transmit_16bit(packet_length);    		// Varies based on command
 	UART1_Transmit(pkt_identifier);         		// API Identifier-> TX Request with 64 bits serial number
@@ -184,13 +246,13 @@ static void remote_AT_command_request(uint32_t SL, uint32_t SH, uint8_t packet_l
 	UART1_Transmit_32bit(SL);               		// Serial Number Low
 	UART1_Transmit(0xFF);					  		// Destination network address (broadcast)
 	UART1_Transmit(0xFE);					  		// Destination network address (broadcast)
-	UART1_Transmit(0x02);					  		// Set AT command (ignored if query)
+	UART1_Transmit(options);				  		// Apply or queue a set (ignored if query)
 	UART1_Transmit(API_pkt.AT_cmd[0]);          	// First char of AT command
 	UART1_Transmit(API_pkt.AT_cmd[1]);          	// Second char of AT command
 
 	checksum = (0xFF - (uint8_t)(pkt_identifier + pkt_ID + sum_of_bytes(SH) + sum_of_bytes(SL)
-  					+ 0xFE + 0xFF + 0x02 + API_pkt.AT_cmd[0] + API_pkt.AT_cmd[1] + API_pkt.AT_cmd_value[0]
-					+ API_pkt.AT_cmd_value[1]) ) ;
+  					+ 0xFE + 0xFF + options + API_pkt.AT_cmd[0] + API_pkt.AT_cmd[1] + API_pkt.AT_cmd_value[0]
+					+ API_pkt.AT_cmd_value[1] + API_pkt.AT_cmd_value[2] + API_pkt.AT_cmd_value[3]) ) ;
 
 	// If packet_length is greater than 15, command parameters are present
   	for ( i = 0; i < (packet_length - 15); i++ )
@@ -203,25 +265,34 @@ static void remote_AT_command_request(uint32_t SL, uint32_t SH, uint8_t packet_l
 	UART1_Transmit(checksum);           // Sends CRC to module
 }
 
-static void local_AT_command_request(uint8_t packet_length)
+static void local_AT_command_request(uint8_t packet_length, bool ack)
 {
-	increment_pkt();
-	uint8_t i, checksum, pkt_identifier;
+	uint8_t i, checksum, pkt_identifier, pkt_ID;
+
+	if ( ack )  {
+		increment_pkt();
+		pkt_ID = API_pkt.Frame_ID;
+	}
+	else
+		pkt_ID = 0;									// No response expected
+
   	pkt_identifier = 0x08;               		// 0x08->AT Command
+	UART1_tx_wait(packet_length + 4);			// delimiter, length and checksum
 
 	UART1_Transmit(API_start_delimiter); 		// Start delimiter
 	UART1_Transmit_16bit(packet_length);   		// Length
 	UART1_Transmit(pkt_identifier);      		// API Identifier->AT Command
-	UART1_Transmit(API_pkt.Frame_ID);        	// Frame ID (for ack)
+	UART1_Transmit(pkt_ID);			        	// Frame ID (for ack)
 	UART1_Transmit(API_pkt.AT_cmd[0]);       	// First char of AT command
 	UART1_Transmit(API_pkt.AT_cmd[1]);       	// Second char of AT command
 
 	for ( i = 0; i < (packet_length - 4); i++ )
   		UART1_Transmit(API_pkt.AT_cmd_value[i]);
 
-	checksum = (0xFF - (uint8_t)(	pkt_identifier + API_pkt.Frame_ID +
+	checksum = (0xFF - (uint8_t)(	pkt_identifier + pkt_ID +
   									API_pkt.AT_cmd[0] + API_pkt.AT_cmd[1] +
-									API_pkt.AT_cmd_value[0] + API_pkt.AT_cmd_value[1]) ) ;
+									API_pkt.AT_cmd_value[0] + API_pkt.AT_cmd_value[1] +
+									API_pkt.AT_cmd_value[2] + API_pkt.AT_cmd_value[3]) ) ;
 	for (i = 0; i < 4; i++)
   		API_pkt.AT_cmd_value[i] = 0;
 
@@ -21,6 +21,9 @@
 #define REMOTE_AT_COMMAND_RESPONSE	0x97
 #define ND_RESPONSE 				0x4E44
 #define DIO_sample					0x4953
+#define IO_SAMPLE_RX				0x92
+#define SERIAL_HIGH					0x5348
+#define SERIAL_LOW					0x534C
 
 #define WIRELESS_SLEEP_STARTED		0x534D
 #define PIN_HIGH 					0x05
@@ -35,15 +38,38 @@
 #define ACK							1
 #define NO_ACK						0
 
+#define REMOTE_OPT_QUEUE			0x00		// remote AT options: hold the change until AC
+#define REMOTE_OPT_APPLY			0x02		// apply the change now
+
 void xbee_set_sleep_time(uint16_t sleep_time);
-void xbee_set_wake_time(uint16_t wake_time);
+void xbee_set_wake_time(uint16_t wake_time, bool ack);
 void xbee_set_sleep_coord(bool send_status_messages);
 void xbee_start_sleep_coord();
-void xbee_start_network_sleep(uint32_t SL, uint32_t SH);
+uint8_t xbee_start_network_sleep(uint32_t SL, uint32_t SH);
 void xbee_node_discover();
+void xbee_read_address();
 uint16_t xbee_sample_batt(uint32_t SL, uint32_t SH);
 void xbee_clear_error_flags();
 
+/*
+ * Description: Enter or leave queued-parameter mode. While it is on, remote
+ *				parameter writes (xbee_set_DIO, xbee_set_pullups) are sent
+ *				unacknowledged with the "queue, don't apply" option; the node
+ *				holds them until xbee_apply_changes.
+ * Input: true to queue, false to apply each write as it arrives
+ * Output: none
+ */
+void xbee_queue_parameters(bool queue);
+
+/*
+ * Description: Send AC to a remote node so it applies all queued parameters,
+ *				and leave queued-parameter mode. This is the one acknowledged
+ *				command of the batch.
+ * Input: Address of remote node SH and SL.
+ * Output: frame ID of the AC command
+ */
+uint8_t xbee_apply_changes(uint32_t SL, uint32_t SH);
+
 /*
  * Description: Send command to remote XBee node, such as set or sample I/O, read parameter
  * Input: Address of remote node SH and SL, length of packet to send, whether a response is expected or not
@@ -65,6 +91,20 @@ uint8_t xbee_set_DIO(uint32_t SL, uint32_t SH, uint8_t pin, uint8_t pin_state, b
  */
 void xbee_set_pullups(uint32_t SL, uint32_t SH, uint16_t pullups);
 
+/*
+ * Description: Set where a remote node sends its IO samples (DH, DL).
+ * Input: Address of remote node SH and SL, destination address DL and DH.
+ * Output: none
+ */
+void xbee_set_destination(uint32_t SL, uint32_t SH, uint32_t DL, uint32_t DH);
+
+/*
+ * Description: Set the IO sample rate of a remote node (IR); 0 stops sampling.
+ * Input: Address of remote node SH and SL, rate in ms.
+ * Output: none
+ */
+void xbee_set_sample_rate(uint32_t SL, uint32_t SH, uint16_t rate_ms);
+
 /*
  * Description: Samples all enabled digital and analog channels of remote XBee.
  * Input: Address of remote node SH and SL.
@@ -81,9 +121,9 @@ static void increment_pkt();
 
 /*
  * Description: Send command to local XBee node, the one attached to SDI-12 port.
- * Input: Length of packet to send. Varies with the command.
+ * Input: Length of packet to send. Varies with the command. Whether a response is expected or not.
  * Output: none
  */
-static void local_AT_command_request(uint8_t length);
+static void local_AT_command_request(uint8_t length, bool ack);
 
 #endif